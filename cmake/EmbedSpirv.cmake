@@ -0,0 +1,35 @@
+# Writes the SPIR-V binary INPUT to OUTPUT as a header defining the
+# constexpr uint32_t array SYMBOL in namespace EmbeddedShaders.
+#
+#   cmake -DINPUT=<file.spv> -DOUTPUT=<file.h> -DSYMBOL=<name> -P EmbedSpirv.cmake
+
+file(READ "${INPUT}" bytes HEX)
+
+string(LENGTH "${bytes}" length)
+math(EXPR remainder "${length} % 8")
+if(length EQUAL 0 OR NOT remainder EQUAL 0)
+  message(FATAL_ERROR "${INPUT} is not a SPIR-V module")
+endif()
+
+# SPIR-V words are little-endian; six words per line
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " words "${bytes}")
+string(REPEAT "0x[0-9a-f]+, " 6 line)
+string(REGEX REPLACE "(${line})" "\\1\n" words "${words}")
+string(REGEX REPLACE " \n" "\n    " words "    ${words}")
+string(REGEX REPLACE "[ \n]+$" "" words "${words}")
+
+get_filename_component(source "${INPUT}" NAME)
+file(WRITE "${OUTPUT}"
+"// Generated from ${source} by EmbedSpirv.cmake, do not edit
+#pragma once
+
+#include <cstdint>
+
+namespace EmbeddedShaders {
+
+constexpr uint32_t ${SYMBOL}[] = {
+${words}
+};
+
+} // namespace EmbeddedShaders
+")
@@ -1,4 +0,0 @@
-#!/bin/zsh
-
-glslc ../shaders/Basic.vert -o Basic.vert.spv
-glslc ../shaders/Basic.frag -o Basic.frag.spv
\ No newline at end of file
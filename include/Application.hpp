@@ -1,15 +1,48 @@
 #pragma once
 
+#include "ComputeScheduler.hpp"
+#include "CullingPass.hpp"
+#include "DeviceBenchmark.hpp"
+#include "DescriptorHeap.hpp"
+#include "DeviceCapabilities.hpp"
+#include "FramePacer.hpp"
+#include "GpuProfiler.hpp"
+#include "IndirectScene.hpp"
 #include "MainWindow.hpp"
+#include "MemoryAllocator.hpp"
+#include "ObjectCache.hpp"
+#include "PipelineVariants.hpp"
+#include "RenderGraph.hpp"
+#include "Settings.hpp"
+#include "ShaderLibrary.hpp"
+#include "ShaderWatcher.hpp"
+#include "StartupProfile.hpp"
+#include "ThreadPool.hpp"
+#include "Timeline.hpp"
+#include "UploadManager.hpp"
 #include "Utils.hpp"
+#include "ValidationSink.hpp"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
 #include <cstring>
+#include <deque>
+#include <functional>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <optional>
 #include <set>
+#include <tuple>
 #include <unordered_set>
 #include <vector>
 
@@ -25,7 +58,7 @@ DestroyDebugUtilsMessengerEXT(VkInstance instance,
 
 class Application {
 public:
-  Application();
+  explicit Application(Settings const &settings = {});
   ~Application();
 
   void init();
@@ -35,47 +68,157 @@ private:
   struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // A family with transfer but neither graphics nor compute support, which
+    // usually maps to a DMA engine
+    std::optional<uint32_t> transferFamily;
+    // A family with compute but no graphics support, or failing that the
+    // graphics family when it has a second queue to spare
+    std::optional<uint32_t> computeFamily;
+    uint32_t computeQueueIndex = 0;
 
     bool isComplete() const {
       return graphicsFamily.has_value() && presentFamily.has_value();
     }
   };
 
-  struct SwapchainSupportDetails {
-    VkSurfaceCapabilitiesKHR capabilities;
-    std::vector<VkSurfaceFormatKHR> formats;
-    std::vector<VkPresentModeKHR> presentModes;
+  struct DrawCommand {
+    uint32_t vertexCount;
+    uint32_t instanceCount;
+    uint32_t firstVertex;
+    uint32_t firstInstance;
   };
 
-  Window::MainWindow m_window;
+  Settings m_settings;
+  // Started along with the application, before the window is created
+  StartupProfile m_startupProfile;
+  // Frame rate limit and frame latency, per Settings::frameRateLimit
+  FramePacer m_framePacer;
+  // Empty in headless mode
+  std::optional<Window::MainWindow> m_window;
 
   VkInstance m_vulkanInstance;
-  VkSurfaceKHR m_surface;
+  // Version the instance was created with, 1.1 or 1.2
+  uint32_t m_apiVersion = VK_API_VERSION_1_1;
+  VkSurfaceKHR m_surface = VK_NULL_HANDLE;
   VkPhysicalDevice m_physicalDevice;
+  // Snapshot of m_physicalDevice taken while picking it
+  DeviceCapabilities m_deviceCapabilities;
+  QueueFamilyIndices m_queueFamilies;
   VkDevice m_device;
   VkQueue m_graphicsQueue;
   VkQueue m_presentQueue;
-  VkSwapchainKHR m_swapchain;
+  VkQueue m_transferQueue;
+  // VK_NULL_HANDLE without a queue for async compute
+  VkQueue m_computeQueue = VK_NULL_HANDLE;
+  VkPhysicalDeviceFeatures m_enabledFeatures{};
+  // Whether the timelines below run on timeline semaphores or fences
+  bool m_timelineSemaphores = false;
+  // Every submission to a queue goes through its timeline. Uploads share the
+  // graphics timeline without a dedicated transfer queue, and there is a
+  // compute timeline only with async compute.
+  std::unique_ptr<Timeline> m_graphicsTimeline;
+  std::unique_ptr<Timeline> m_transferTimeline;
+  std::unique_ptr<Timeline> m_computeTimeline;
+  // Null unless VK_KHR_draw_indirect_count is enabled
+  PFN_vkCmdDrawIndexedIndirectCountKHR m_cmdDrawIndexedIndirectCount = nullptr;
+  // With VK_KHR_dynamic_rendering there is no render pass or framebuffer;
+  // pipelines name their attachment formats and recording names the images
+  bool m_dynamicRendering = false;
+  PFN_vkCmdBeginRenderingKHR m_cmdBeginRendering = nullptr;
+  PFN_vkCmdEndRenderingKHR m_cmdEndRendering = nullptr;
+  // Set with Settings::bindless on a device that can back m_descriptorHeap
+  bool m_descriptorIndexing = false;
+  VkSwapchainKHR m_swapchain = VK_NULL_HANDLE;
+  // In headless mode the swapchain members describe the offscreen targets
   std::vector<VkImage> m_swapchainImages;
+  std::vector<MemoryAllocator::Allocation> m_offscreenImageAllocations;
   VkFormat m_swapchainImageFormat;
   VkExtent2D m_swapchainExtent;
   std::vector<VkImageView> m_swapchainImageViews;
-  VkRenderPass m_renderPass;
+  // Shared by every framebuffer; also read back by occlusion culling
+  VkFormat m_depthFormat;
+  VkImage m_depthImage = VK_NULL_HANDLE;
+  MemoryAllocator::Allocation m_depthImageAllocation;
+  VkImageView m_depthImageView = VK_NULL_HANDLE;
+  // VK_NULL_HANDLE with dynamic rendering, as are the framebuffers
+  VkRenderPass m_renderPass = VK_NULL_HANDLE;
+  VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+  // Read in the background from the start of init until createPipelineCache
+  std::future<std::optional<Utils::MappedFile>> m_pipelineCacheData;
   VkPipelineLayout m_pipelineLayout;
+  // Generic pipeline, drawn with until the variant the settings ask for has
+  // compiled on m_pipelineThreads
   VkPipeline m_graphicsPipeline;
+  std::future<VkPipeline> m_graphicsPipelineBuild;
+  // Takes the work init overlaps, then builds pipelines in the background
+  std::unique_ptr<ThreadPool> m_pipelineThreads;
+  std::unique_ptr<PipelineVariants> m_pipelineVariants;
+  PipelineVariants::Handle m_pipelineVariant;
+  // Shader hot reload, only with Settings::shaderSourceDirectory. The generic
+  // pipeline is rebuilt in the background and swapped in between frames.
+  std::unique_ptr<ShaderWatcher> m_shaderWatcher;
+  std::future<VkPipeline> m_pipelineRebuild;
+  // Set by the watcher thread when a graphics shader was recompiled
+  std::atomic<bool> m_graphicsShadersChanged{false};
   std::vector<VkFramebuffer> m_swapchainFramebuffers;
   VkCommandPool m_commandPool;
-  VkCommandBuffer m_commandBuffer;
-  VkSemaphore m_imageAvailableSemaphore;
-  VkSemaphore m_renderFinishedSemaphore;
-  VkFence m_inFlightFence;
+  std::vector<VkCommandBuffer> m_commandBuffers;
+  // RecordMode::Prerecorded only, one per swapchain framebuffer
+  std::vector<VkCommandBuffer> m_imageCommandBuffers;
+  std::vector<bool> m_imageCommandBuffersDirty;
+  // RecordMode::Parallel only, indexed by frame in flight and then worker
+  std::unique_ptr<ThreadPool> m_recordingThreads;
+  std::vector<std::vector<VkCommandPool>> m_workerCommandPools;
+  std::vector<std::vector<VkCommandBuffer>> m_workerCommandBuffers;
+  std::vector<VkSemaphore> m_imageAvailableSemaphores;
+  std::vector<VkSemaphore> m_renderFinishedSemaphores;
+  // Graphics points of the last frame submitted per frame in flight and per
+  // swapchain image
+  std::vector<uint64_t> m_framePoints;
+  std::vector<uint64_t> m_imagePoints;
+  uint32_t m_currentFrame = 0;
+  // CPU time spent recording command buffers, summed over all frames
+  std::chrono::duration<double> m_recordingTime{};
+
+  // Objects still referenced by frames in flight, destroyed once the graphics
+  // queue has moved past them
+  struct DeferredDestruction {
+    // Graphics point of the last submission that may use the object
+    uint64_t retiredAt;
+    std::function<void()> destroy;
+  };
+  std::deque<DeferredDestruction> m_deferredDestructions;
+
+  std::unique_ptr<MemoryAllocator> m_allocator;
+  // Render passes, layouts, samplers and pipelines, shared by content
+  std::unique_ptr<ObjectCache> m_objectCache;
+  std::unique_ptr<UploadManager> m_uploadManager;
+  // Set 0 of the graphics pipeline layout, bound once per command buffer.
+  // Null without descriptor indexing, when the scene binds its own set.
+  std::unique_ptr<DescriptorHeap> m_descriptorHeap;
+  // Only while there is compute work to move off the graphics queue
+  std::unique_ptr<ComputeScheduler> m_computeScheduler;
+  // Families sharing resources with the async compute queue, or empty when
+  // it belongs to the graphics family
+  std::vector<uint32_t> m_computeSharingFamilies;
+  std::unique_ptr<GpuProfiler> m_profiler;
+
+  std::vector<DrawCommand> m_drawCommands;
+  std::unique_ptr<IndirectScene> m_indirectScene;
+  // Graphics points of the last frame that drew each scene output
+  std::vector<uint64_t> m_sceneOutputPoints;
+  std::unique_ptr<CullingPass> m_cullingPass;
+  IndirectScene::View m_view{};
+  // Passes of a frame, rebuilt with the swapchain
+  std::unique_ptr<RenderGraph> m_renderGraph;
 
   VkDebugUtilsMessengerEXT debugMessenger;
+  // Outlives the instance, which reports through it until destroyed
+  std::unique_ptr<ValidationSink> m_validationSink;
 
   const std::vector<char const *> m_validationLayers = {
       "VK_LAYER_KHRONOS_validation"};
-  const std::vector<char const *> m_deviceExtensions = {
-      VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  std::vector<char const *> m_deviceExtensions;
 
 #ifdef NDEBUG
   const bool m_enableValidationLayers = false;
@@ -83,52 +226,94 @@ private:
   const bool m_enableValidationLayers = true;
 #endif
 
+  void createWorkerThreads();
+  void loadPipelineCacheData();
   void createVulkanInstance();
   void setupDebugMessenger();
   void createSurface();
   void pickPhysicalDevice();
   void createLogicalDevice();
+  void createMemoryAllocator();
+  void createObjectCache();
+  void createUploadManager();
+  void createDescriptorHeap();
+  void createComputeScheduler();
   void createSwapchain();
+  void recreateSwapchain();
+  void deferDestruction(std::function<void()> destroy);
+  void destroyRetiredObjects(bool all = false);
+  void createOffscreenTargets();
   void createImageViews();
+  void createDepthResources();
+  VkFormat findDepthFormat() const;
   void createRenderPass();
+  void createPipelineCache();
+  void savePipelineCache() const;
   void createGraphicsPipeline();
+  std::vector<VkPipeline>
+  buildGraphicsPipelines(std::vector<PipelineVariants::Key> const &keys) const;
+  std::array<std::string, 2> graphicsShaders() const;
+  void finishGraphicsPipeline();
+  void requestPipelineVariants();
+  void createShaderWatcher();
+  void updateGraphicsPipeline();
   void createFramebuffers();
   void createCommandPool();
-  void createCommandBuffer();
-  void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t index);
+  void createCommandBuffers();
+  void createImageCommandBuffers();
+  void createWorkerCommandBuffers();
+  void createScene();
+  void createCullingPass();
+  void createRenderGraph();
+  void
+  submitOneTimeCommands(std::function<void(VkCommandBuffer)> const &record);
+  void markCommandBuffersDirty();
+  uint32_t sceneOutput(uint32_t index) const;
+  void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t index,
+                           uint32_t profilerSlot);
+  void recordMainPass(VkCommandBuffer commandBuffer, uint32_t index);
+  void beginRendering(VkCommandBuffer commandBuffer, uint32_t index,
+                      bool secondaryCommandBuffers);
+  void endRendering(VkCommandBuffer commandBuffer);
+  std::vector<VkCommandBuffer> recordSecondaryCommandBuffers(uint32_t index);
+  void recordDraws(VkCommandBuffer commandBuffer, size_t begin, size_t end);
+  void recordViewportAndScissor(VkCommandBuffer commandBuffer);
   void drawFrame();
+  void runHeadless();
   void createSyncObjects();
+  void createProfiler();
+  void reportProfile();
   void cleanup();
 
   bool checkValidationLayerSupport() const;
   std::vector<const char *> getRequiredExtensions();
 
-  static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice,
-                                              VkSurfaceKHR surface);
-  static std::optional<VkPhysicalDevice>
-  mostSuitableDevice(const std::vector<VkPhysicalDevice> &physicalDevices,
-                     VkSurfaceKHR surface,
-                     std::vector<char const *> const &requiredExtensions);
-  static bool checkDeviceExtensionSupport(
-      VkPhysicalDevice physicalDevice,
-      std::vector<char const *> const &requiredExtensions);
-  static SwapchainSupportDetails
-  querySwapchainSupport(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
+  static QueueFamilyIndices findQueueFamilies(DeviceCapabilities const &device);
+  static bool
+  isDeviceSuitable(DeviceCapabilities const &device,
+                   std::vector<char const *> const &requiredExtensions);
+  // Indices into `devices`; `benchmark` may be null
+  static std::optional<size_t>
+  mostSuitableDevice(std::vector<DeviceCapabilities> const &devices,
+                     std::vector<char const *> const &requiredExtensions,
+                     DeviceBenchmark *benchmark);
+  static std::optional<size_t>
+  requestedDevice(std::vector<DeviceCapabilities> const &devices,
+                  std::string const &request);
   static VkSurfaceFormatKHR
   chooseSwapSurfaceFormat(std::vector<VkSurfaceFormatKHR> const &formats);
+  static VkPresentModeKHR toVkPresentMode(PresentMode mode);
   static VkPresentModeKHR
-  chooseSwapPresentMode(std::vector<VkPresentModeKHR> const &modes);
+  chooseSwapPresentMode(std::vector<VkPresentModeKHR> const &modes,
+                        PresentMode preferred);
   static VkExtent2D
   chooseSwapExtent(VkSurfaceCapabilitiesKHR const &capabilities,
                    Size<uint32_t> windowSize);
-  static VkShaderModule createShaderModule(std::vector<char> const &code,
-                                           VkDevice device);
+  static bool
+  isPipelineCacheCompatible(void const *data, size_t size,
+                            VkPhysicalDeviceProperties const &properties);
 
-  static void populateDebugMessengerCreateInfo(
+  void createValidationSink();
+  void populateDebugMessengerCreateInfo(
       VkDebugUtilsMessengerCreateInfoEXT &createInfo);
-
-  static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
-      VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-      VkDebugUtilsMessageTypeFlagsEXT messageType,
-      const VkDebugUtilsMessengerCallbackDataEXT *callbackData, void *userData);
 };
\ No newline at end of file
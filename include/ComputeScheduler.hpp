@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Timeline.hpp"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Submits compute work on an async compute queue, so it can run in the gaps
+// of the graphics queue instead of being serialized behind it.
+//
+// Jobs queued for a frame are recorded into one command buffer per frame in
+// flight. The graphics submission of the same frame waits on the point the
+// submission returns, and the submission waits on the graphics point the
+// caller passes: the last one that used what the jobs read or rewrite. No
+// other synchronization with graphics work is needed. Both timelines have to
+// use timeline semaphores, or every submission would stall the CPU on the
+// graphics queue.
+//
+// Jobs only overlap the graphics work of other frames when they write
+// resources of their own frame in flight, so that point can be older than
+// the latest graphics submission.
+//
+// Resources used on both queues must either belong to the same queue family
+// or be created with VK_SHARING_MODE_CONCURRENT.
+class ComputeScheduler {
+public:
+  using RecordFunction = std::function<void(VkCommandBuffer)>;
+
+  ComputeScheduler(VkDevice device, uint32_t computeFamily,
+                   Timeline &computeTimeline, Timeline &graphicsTimeline,
+                   uint32_t framesInFlight);
+  ~ComputeScheduler();
+
+  ComputeScheduler(ComputeScheduler const &) = delete;
+  ComputeScheduler &operator=(ComputeScheduler const &) = delete;
+
+  // Queues a job for the next submit(). `stages` are the first stages the job
+  // uses, and wait on the graphics point given to submit().
+  void addJob(VkPipelineStageFlags stages, RecordFunction record);
+
+  // Records and submits the queued jobs of frame in flight `frame`, after
+  // graphics point `graphicsPoint`. Returns the compute point the graphics
+  // submission of that frame has to wait on, or 0 when no job was queued.
+  uint64_t submit(uint32_t frame, uint64_t graphicsPoint);
+
+private:
+  struct Job {
+    VkPipelineStageFlags stages;
+    RecordFunction record;
+  };
+
+  struct Frame {
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // Of the last submission recorded into commandBuffer
+    uint64_t point = 0;
+  };
+
+  VkDevice m_device;
+  Timeline &m_timeline;
+  Timeline &m_graphicsTimeline;
+  std::vector<Frame> m_frames;
+  std::vector<Job> m_jobs;
+};
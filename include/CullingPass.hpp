@@ -0,0 +1,98 @@
+#pragma once
+
+#include "IndirectScene.hpp"
+#include "MemoryAllocator.hpp"
+#include "ObjectCache.hpp"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Compute pass recorded ahead of the render pass that culls the instances of
+// an IndirectScene against the view and, optionally, against a hierarchical
+// depth pyramid built from the previous frame's depth buffer. Survivors are
+// compacted into the visible list and indirect commands of one of the scene's
+// outputs.
+//
+// The frame must leave the depth buffer in DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+// with its writes visible to compute shaders, and the buffer must hold valid
+// depth before the first frame is submitted.
+//
+// With `asyncCompute` the pass is recorded on a compute queue and the
+// ComputeScheduler's semaphores order it against the draws, so the barriers
+// against graphics stages are left out.
+class CullingPass {
+public:
+  CullingPass(VkDevice device, MemoryAllocator &allocator,
+              ObjectCache &objects, VkPipelineCache pipelineCache,
+              IndirectScene const &scene, bool occlusion, bool asyncCompute,
+              std::string const &shaderDirectory = {});
+  ~CullingPass();
+
+  CullingPass(CullingPass const &) = delete;
+  CullingPass &operator=(CullingPass const &) = delete;
+
+  // (Re)creates the pyramid for a depth buffer of `extent`. Resources of the
+  // previous pyramid are handed to `retire`, since frames in flight may still
+  // use them.
+  void resize(VkImage depthImage, VkFormat depthFormat, VkExtent2D extent,
+              std::function<void(std::function<void()>)> const &retire);
+
+  // Records outside a render pass, writing scene output `output`
+  void record(VkCommandBuffer commandBuffer, IndirectScene::View const &view,
+              uint32_t output = 0) const;
+
+private:
+  struct Pyramid {
+    // Depth aspect only view of the depth buffer, as the input of level 0
+    VkImageView depthView = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    MemoryAllocator::Allocation allocation;
+    VkImageView view = VK_NULL_HANDLE;
+    std::vector<VkImageView> levelViews;
+    VkExtent2D extent{};
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    // One per level, reading the level below and writing its own
+    std::vector<VkDescriptorSet> levelSets;
+    // One per scene output
+    std::vector<VkDescriptorSet> cullSets;
+  };
+
+  // Matches the push constants of Cull.comp
+  struct CullParameters {
+    float center[2];
+    float zoom;
+    uint32_t instanceCount;
+    float pyramidSize[2];
+    uint32_t pyramidLevels;
+    uint32_t occlusion;
+  };
+
+  void createPipelines(VkPipelineCache pipelineCache,
+                       std::string const &shaderDirectory);
+  void createPyramidViews(VkImage depthImage, VkFormat depthFormat);
+  void createPyramidDescriptorSets();
+  void destroyPyramid(Pyramid &pyramid);
+  void recordPyramid(VkCommandBuffer commandBuffer) const;
+
+  VkDevice m_device;
+  MemoryAllocator &m_allocator;
+  ObjectCache &m_objects;
+  IndirectScene const &m_scene;
+  bool m_occlusion;
+  bool m_asyncCompute;
+
+  VkSampler m_sampler = VK_NULL_HANDLE;
+  VkDescriptorSetLayout m_pyramidSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout m_pyramidPipelineLayout = VK_NULL_HANDLE;
+  VkPipeline m_pyramidPipeline = VK_NULL_HANDLE;
+  VkDescriptorSetLayout m_cullSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+  VkPipeline m_cullPipeline = VK_NULL_HANDLE;
+
+  Pyramid m_pyramid;
+};
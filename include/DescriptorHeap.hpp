@@ -0,0 +1,81 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// One descriptor set holding every storage buffer, sampled image and sampler
+// shaders may reach, bound once per command buffer. Shaders index its arrays
+// with the 32-bit handles returned here, which reach them through push
+// constants, so draws never bind descriptors of their own.
+//
+// The set is update-after-bind and partially bound: handles can be added and
+// removed while command buffers binding it are recorded or in flight, as long
+// as those don't use the slots that change, and slots never written are
+// simply never read. A removed handle is reused by a later add, so it must
+// only be removed once no frame uses it any more.
+class DescriptorHeap {
+public:
+  // Also declared by the shaders, in set 0
+  static constexpr uint32_t bufferBinding = 0;
+  static constexpr uint32_t imageBinding = 1;
+  static constexpr uint32_t samplerBinding = 2;
+
+  // Slots per array, lowered to what the device allows
+  struct Capacity {
+    uint32_t buffers = 16384;
+    uint32_t images = 16384;
+    uint32_t samplers = 256;
+  };
+
+  DescriptorHeap(VkDevice device,
+                 VkPhysicalDeviceDescriptorIndexingProperties const &limits,
+                 Capacity capacity);
+  ~DescriptorHeap();
+
+  DescriptorHeap(DescriptorHeap const &) = delete;
+  DescriptorHeap &operator=(DescriptorHeap const &) = delete;
+
+  VkDescriptorSetLayout layout() const;
+  Capacity capacity() const;
+
+  // Thread safe. Removing a handle that isn't in the heap throws.
+  uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0,
+                     VkDeviceSize range = VK_WHOLE_SIZE);
+  uint32_t addImage(VkImageView view, VkImageLayout layout);
+  uint32_t addSampler(VkSampler sampler);
+  void removeBuffer(uint32_t handle);
+  void removeImage(uint32_t handle);
+  void removeSampler(uint32_t handle);
+
+  // Binds the set as set 0 of `pipelineLayout`, which every pipeline drawn
+  // with afterwards must stay compatible with
+  void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+            VkPipelineLayout pipelineLayout) const;
+
+private:
+  struct Slots {
+    uint32_t capacity;
+    // Slots below it have been handed out at least once
+    uint32_t used = 0;
+    std::vector<uint32_t> free;
+    // Per slot below `used`, whether it's handed out right now
+    std::vector<bool> live;
+  };
+
+  uint32_t allocate(Slots &slots, char const *kind);
+  void release(Slots &slots, uint32_t handle, char const *kind);
+
+  VkDevice m_device;
+  VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+  VkDescriptorPool m_pool = VK_NULL_HANDLE;
+  VkDescriptorSet m_set = VK_NULL_HANDLE;
+
+  std::mutex m_mutex;
+  Slots m_buffers;
+  Slots m_images;
+  Slots m_samplers;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "DeviceCapabilities.hpp"
+
+#include <map>
+#include <optional>
+#include <string>
+
+// Short startup micro-benchmark for telling apart devices that look alike on
+// paper: times copies between device-local buffers on a throwaway logical
+// device. Results are cached by device UUID and driver version, so only the
+// first run on a machine, or after a driver update, pays for it.
+class DeviceBenchmark {
+public:
+  // Loads the results cached at `cachePath`; empty keeps them in memory only
+  explicit DeviceBenchmark(std::string cachePath);
+
+  DeviceBenchmark(DeviceBenchmark const &) = delete;
+  DeviceBenchmark &operator=(DeviceBenchmark const &) = delete;
+
+  // Copy bandwidth in GB/s, measured unless cached; empty when the device
+  // can't be timed
+  std::optional<double> copyBandwidth(DeviceCapabilities const &device);
+
+  // Writes results measured since loading back to the cache
+  void save() const;
+
+private:
+  static std::string key(DeviceCapabilities const &device);
+  // Throws when any step fails
+  static double measure(DeviceCapabilities const &device);
+
+  std::string m_cachePath;
+  std::map<std::string, double> m_results;
+  bool m_changed = false;
+};
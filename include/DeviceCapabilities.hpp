@@ -0,0 +1,50 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Everything the renderer needs to know about a physical device, queried
+// once, so that ranking the devices and setting up the chosen one never ask
+// the driver the same question twice
+struct DeviceCapabilities {
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties properties{};
+  // The lower of the device's version and the instance's
+  uint32_t apiVersion = 0;
+  // Identifies the device across runs, unlike its handle
+  std::array<uint8_t, VK_UUID_SIZE> deviceUUID{};
+  VkPhysicalDeviceFeatures features{};
+  VkPhysicalDeviceMemoryProperties memory{};
+  std::vector<VkQueueFamilyProperties> queueFamilies;
+  std::unordered_set<std::string> extensions;
+  // Core in Vulkan 1.2, otherwise through VK_KHR_timeline_semaphore
+  bool timelineSemaphore = false;
+  // VK_KHR_dynamic_rendering, only taken on Vulkan 1.2 where the extensions
+  // it depends on are core
+  bool dynamicRendering = false;
+  // Everything DescriptorHeap relies on: descriptor indexing, core in Vulkan
+  // 1.2 and otherwise through VK_EXT_descriptor_indexing, with update after
+  // bind and partially bound sets. Its limits are only filled in when set.
+  bool descriptorIndexing = false;
+  VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{};
+
+  // Surface support, all empty without a surface. The surface capabilities
+  // themselves change with the window and are queried when needed.
+  std::vector<bool> presentSupport;
+  std::vector<VkSurfaceFormatKHR> surfaceFormats;
+  std::vector<VkPresentModeKHR> presentModes;
+
+  static DeviceCapabilities query(VkPhysicalDevice physicalDevice,
+                                  VkSurfaceKHR surface,
+                                  uint32_t instanceApiVersion);
+
+  bool hasExtensions(std::vector<char const *> const &names) const;
+  // Summed size of the heaps local to the device
+  VkDeviceSize deviceLocalMemory() const;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <ostream>
+
+// Caps the frame rate on the CPU and measures each frame from its start to
+// its present being queued, which is when the frame leaves the application's
+// hands. Waiting sleeps until shortly before the deadline and spins through
+// the rest, since sleeps overshoot by more than a frame can spare.
+class FramePacer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Zero frames per second paces nothing and only measures
+  explicit FramePacer(double framesPerSecond = 0.0,
+                      size_t historyLength = 1000);
+
+  // Waits out the rest of the frame interval, then starts timing a frame
+  void beginFrame();
+  // Call once the present of the frame is queued; frames that end without
+  // one are left out
+  void endFrame();
+
+  void writeSummary(std::ostream &stream) const;
+
+private:
+  struct Sample {
+    // From the start of the frame to its present
+    double latencyMs;
+    // Between the starts of this frame and the previous one
+    double intervalMs;
+  };
+
+  Clock::duration m_interval{};
+  size_t m_historyLength;
+  Clock::time_point m_deadline{};
+  Clock::time_point m_frameStart{};
+  Clock::time_point m_previousFrameStart{};
+  std::deque<Sample> m_history;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Times render passes on the GPU with timestamp and pipeline-statistics
+// queries. Each slot owns its own queries; a slot is read back only after the
+// fence of the submission that used it has signaled, so results always come
+// from a frame the GPU has already finished and never stall the CPU.
+//
+// Recording and submission are tracked separately so a command buffer that is
+// recorded once and submitted many times still produces a sample per
+// submission.
+class GpuProfiler {
+public:
+  struct PipelineStatistics {
+    uint64_t inputAssemblyVertices = 0;
+    uint64_t inputAssemblyPrimitives = 0;
+    uint64_t vertexShaderInvocations = 0;
+    uint64_t clippingInvocations = 0;
+    uint64_t clippingPrimitives = 0;
+    uint64_t fragmentShaderInvocations = 0;
+    uint64_t computeShaderInvocations = 0;
+  };
+
+  struct Sample {
+    uint64_t frame;
+    double milliseconds;
+    PipelineStatistics statistics;
+  };
+
+  GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device,
+              uint32_t queueFamilyIndex, uint32_t slotCount,
+              bool pipelineStatistics, uint32_t maxPasses = 16,
+              size_t historyLength = 240);
+  ~GpuProfiler();
+
+  GpuProfiler(GpuProfiler const &) = delete;
+  GpuProfiler &operator=(GpuProfiler const &) = delete;
+
+  uint32_t slotCount() const;
+  // Of the statistics query active during each pass, or zero without one.
+  // Secondary command buffers executed in a pass must inherit them.
+  VkQueryPipelineStatisticFlags pipelineStatisticFlags() const;
+  // Adds slots up to `slotCount`; existing slots and their results are kept
+  void growSlots(uint32_t slotCount);
+
+  // Resets the queries of `slot`; must be recorded outside a render pass
+  void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+  void beginPass(VkCommandBuffer commandBuffer, uint32_t slot,
+                 std::string const &name);
+  void endPass(VkCommandBuffer commandBuffer, uint32_t slot);
+  // Call each time a command buffer recorded against `slot` is submitted
+  void markSubmitted(uint32_t slot);
+  // Reads back the last submission of `slot`. Call once its fence has been
+  // waited on.
+  void collect(uint32_t slot);
+  // Reads back every slot, oldest submission first. The device must be idle.
+  void collectAll();
+
+  std::vector<std::string> passNames() const;
+  std::vector<Sample> history(std::string const &pass) const;
+  double averageMilliseconds(std::string const &pass) const;
+  double minMilliseconds(std::string const &pass) const;
+  double maxMilliseconds(std::string const &pass) const;
+
+  void writeCsv(std::ostream &stream) const;
+  void writeJson(std::ostream &stream) const;
+  void writeSummary(std::ostream &stream) const;
+
+private:
+  struct Slot {
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    VkQueryPool statisticsPool = VK_NULL_HANDLE;
+    uint64_t frame = 0;
+    std::vector<std::string> passes;
+    bool passOpen = false;
+    bool pending = false;
+  };
+
+  VkDevice m_device;
+  uint32_t m_maxPasses;
+  size_t m_historyLength;
+  bool m_pipelineStatistics;
+  double m_timestampPeriod;
+  uint64_t m_timestampMask;
+  uint64_t m_frameCounter = 0;
+
+  std::vector<Slot> m_slots;
+  std::map<std::string, std::deque<Sample>> m_history;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "DescriptorHeap.hpp"
+#include "MemoryAllocator.hpp"
+#include "ObjectCache.hpp"
+#include "UploadManager.hpp"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+
+// GPU-driven scene: per-instance data lives in a storage buffer and every mesh
+// is drawn by one indirect command, so the CPU cost of a frame does not grow
+// with the number of instances.
+//
+// Instances are drawn through a list of visible instance indices. Without
+// culling it holds every instance; CullingPass rewrites it together with the
+// instance counts of the indirect commands every frame, without the CPU being
+// involved. The indirect commands and the visible list form an output, of
+// which there can be several so culling can write one while the draws of
+// another frame still read another.
+class IndirectScene {
+public:
+  // Matches the std430 layout of `Instance` in the shaders
+  struct Instance {
+    float offset[2];
+    float scale;
+    float rotation;
+    float depth;
+    // Bounding circle around the scaled mesh
+    float radius;
+    // RGBA8, unpacked with unpackUnorm4x8
+    uint32_t color;
+    uint32_t mesh;
+  };
+
+  // Push constant shared by Instanced.vert and Cull.comp
+  struct View {
+    float center[2];
+    float zoom;
+  };
+
+  // Push constant of InstancedBindless.vert: the view, then the heap handles
+  // of the instance and visible buffers
+  struct BindlessView {
+    View view;
+    uint32_t instanceBuffer;
+    uint32_t visibleBuffer;
+  };
+
+  // `drawIndirectCount` may be null, in which case the draw count is taken
+  // from the CPU side. With more than one `cullingFamilies` the buffers
+  // culling touches are shared concurrently between those queue families.
+  // With a `heap` the vertex shader reaches the buffers through it, and the
+  // scene has no descriptor set of its own.
+  IndirectScene(VkDevice device, MemoryAllocator &allocator,
+                ObjectCache &objects, UploadManager &uploads,
+                DescriptorHeap *heap, uint32_t instanceCount,
+                bool multiDrawIndirect,
+                PFN_vkCmdDrawIndexedIndirectCountKHR drawIndirectCount,
+                std::vector<uint32_t> const &cullingFamilies = {},
+                uint32_t outputCount = 1);
+  ~IndirectScene();
+
+  IndirectScene(IndirectScene const &) = delete;
+  IndirectScene &operator=(IndirectScene const &) = delete;
+
+  static std::vector<VkVertexInputBindingDescription> vertexBindings();
+  static std::vector<VkVertexInputAttributeDescription> vertexAttributes();
+
+  // VK_NULL_HANDLE with a heap
+  VkDescriptorSetLayout descriptorSetLayout() const;
+  // Of the vertex stage push constant range record() fills
+  uint32_t pushConstantSize() const;
+  uint32_t instanceCount() const;
+  uint32_t drawCount() const;
+  uint32_t outputCount() const;
+
+  VkBuffer instanceBuffer() const;
+  VkBuffer indirectBuffer(uint32_t output) const;
+  VkBuffer visibleBuffer(uint32_t output) const;
+  // Indirect commands with zero instances, copied over the live ones before
+  // culling refills them
+  VkBuffer resetBuffer() const;
+
+  // Records the whole scene inside a render pass, with a pipeline whose layout
+  // is `pipelineLayout` already bound, and the heap too if there is one
+  void record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
+              View const &view, uint32_t output = 0) const;
+
+private:
+  struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    MemoryAllocator::Allocation allocation;
+  };
+
+  struct Mesh {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    // Distance of the farthest vertex from the origin
+    float radius;
+  };
+
+  struct Output {
+    Buffer indirectBuffer;
+    Buffer visibleBuffer;
+    // Without a heap
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    // With a heap
+    uint32_t visibleHandle = 0;
+  };
+
+  Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                      std::vector<uint32_t> const &families = {});
+  void destroyBuffer(Buffer &buffer);
+  void createDescriptorSets();
+
+  VkDevice m_device;
+  MemoryAllocator &m_allocator;
+  ObjectCache &m_objects;
+  DescriptorHeap *m_heap;
+  uint32_t m_instanceCount;
+  uint32_t m_drawCount = 0;
+  bool m_multiDrawIndirect;
+  PFN_vkCmdDrawIndexedIndirectCountKHR m_drawIndirectCount;
+
+  Buffer m_vertexBuffer;
+  Buffer m_indexBuffer;
+  Buffer m_instanceBuffer;
+  // Only ever holds the draw count, so the outputs share it
+  Buffer m_countBuffer;
+  Buffer m_resetBuffer;
+  std::vector<Output> m_outputs;
+
+  VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+  uint32_t m_instanceHandle = 0;
+};
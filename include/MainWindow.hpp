@@ -22,6 +22,8 @@ public:
   void setSize(Size<int> size);
   bool shouldClose() const;
   void swapBuffers();
+  // True once after the framebuffer has changed size
+  bool takeFramebufferResized();
 
   VkSurfaceKHR createSurface(VkInstance instance) const;
 
@@ -30,7 +32,11 @@ private:
     void operator()(GLFWwindow *window) { glfwDestroyWindow(window); }
   };
 
+  static void framebufferSizeCallback(GLFWwindow *window, int width,
+                                      int height);
+
   std::unique_ptr<GLFWwindow, WindowDeleter> m_window;
+  bool m_framebufferResized = false;
 };
 
 } // namespace Window
\ No newline at end of file
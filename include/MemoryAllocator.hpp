@@ -0,0 +1,117 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <vector>
+
+// Sub-allocates buffers and images from large VkDeviceMemory blocks so the
+// number of live allocations stays far below maxMemoryAllocationCount.
+//
+// Long-lived resources come from buddy pools, one per memory type and per
+// resource kind. Linear and optimal resources never share a pool, which keeps
+// them bufferImageGranularity apart without padding every allocation.
+// Requests larger than a block get a dedicated allocation. Blocks are kept
+// once created and reused by later allocations.
+class MemoryAllocator {
+public:
+  struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // Null unless the memory is host visible
+    void *mapped = nullptr;
+
+    // Internal bookkeeping
+    uint32_t pool = 0;
+    uint32_t block = 0;
+    uint32_t order = 0;
+    bool dedicated = false;
+  };
+
+  struct Statistics {
+    uint32_t blockCount = 0;
+    uint32_t dedicatedCount = 0;
+    uint32_t allocationCount = 0;
+    // Device memory held by the allocator
+    VkDeviceSize reservedBytes = 0;
+    // Bytes asked for by callers
+    VkDeviceSize requestedBytes = 0;
+    // Bytes handed out after rounding to buddy sizes
+    VkDeviceSize allocatedBytes = 0;
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFreeRange = 0;
+    // Sum of the largest free range of every block
+    VkDeviceSize contiguousFreeBytes = 0;
+
+    // Share of handed out bytes lost to rounding
+    double internalFragmentation() const;
+    // Share of free bytes outside the largest free range of their block
+    double externalFragmentation() const;
+  };
+
+  MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device,
+                  VkDeviceSize blockSize = 64ull << 20);
+  ~MemoryAllocator();
+
+  MemoryAllocator(MemoryAllocator const &) = delete;
+  MemoryAllocator &operator=(MemoryAllocator const &) = delete;
+
+  // `linear` is true for buffers and linearly tiled images
+  Allocation allocate(VkMemoryRequirements const &requirements,
+                      VkMemoryPropertyFlags properties, bool linear);
+  void free(Allocation const &allocation);
+
+  // Convenience wrappers that allocate and bind in one step
+  Allocation allocateForBuffer(VkBuffer buffer,
+                               VkMemoryPropertyFlags properties);
+  Allocation allocateForImage(VkImage image, VkMemoryPropertyFlags properties,
+                              bool linearTiling = false);
+
+  uint32_t findMemoryType(uint32_t typeFilter,
+                          VkMemoryPropertyFlags properties) const;
+
+  Statistics statistics() const;
+  void writeStatistics(std::ostream &stream) const;
+
+private:
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = nullptr;
+    // Offsets of the free ranges of each order, order 0 being the smallest
+    std::vector<std::set<VkDeviceSize>> freeLists;
+    uint32_t allocationCount = 0;
+  };
+
+  struct Pool {
+    uint32_t memoryType;
+    bool linear;
+    std::vector<std::unique_ptr<Block>> blocks;
+  };
+
+  uint32_t poolIndex(uint32_t memoryType, bool linear);
+  Block &createBlock(Pool &pool);
+  VkDeviceMemory allocateMemory(uint32_t memoryType, VkDeviceSize size,
+                                void **mapped) const;
+  bool isHostVisible(uint32_t memoryType) const;
+  VkDeviceSize orderSize(uint32_t order) const;
+
+  VkDevice m_device;
+  VkPhysicalDeviceMemoryProperties m_memoryProperties;
+  VkDeviceSize m_blockSize;
+  VkDeviceSize m_minAllocationSize = 256;
+  uint32_t m_orderCount;
+
+  mutable std::mutex m_mutex;
+  std::vector<Pool> m_pools;
+  uint32_t m_dedicatedCount = 0;
+  VkDeviceSize m_dedicatedBytes = 0;
+  uint32_t m_allocationCount = 0;
+  VkDeviceSize m_requestedBytes = 0;
+  VkDeviceSize m_allocatedBytes = 0;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Hash-consed Vulkan objects: acquiring an object whose create info matches a
+// live one returns the existing handle and adds a reference instead of
+// creating another object. Each acquire needs a release, and the object is
+// destroyed with its last reference, so the usual rules about the GPU still
+// using it apply.
+//
+// Create infos are keyed field by field, so padding and the addresses of
+// arrays don't matter and descriptor set layout bindings may come in any
+// order. pNext chains are not supported, apart from the attachment formats of
+// a graphics pipeline for dynamic rendering. Handles inside a create info are
+// keyed by value; those acquired from the same cache are kept alive as long as
+// the objects keyed on them, so a destroyed handle can never be reused under
+// the same key. Pipelines are keyed on their shader modules, so acquire those
+// here too.
+//
+// Safe to use from several threads; objects are created outside the lock.
+class ObjectCache {
+public:
+  enum class Type {
+    ShaderModule,
+    DescriptorSetLayout,
+    PipelineLayout,
+    RenderPass,
+    Sampler,
+    Pipeline,
+  };
+  static constexpr size_t typeCount = 6;
+
+  struct Statistics {
+    struct Counts {
+      uint64_t requests = 0;
+      uint64_t hits = 0;
+      // Objects currently alive
+      uint64_t live = 0;
+    };
+    std::array<Counts, typeCount> types;
+
+    Counts total() const;
+  };
+
+  explicit ObjectCache(VkDevice device);
+  // Destroys whatever is still referenced
+  ~ObjectCache();
+
+  ObjectCache(ObjectCache const &) = delete;
+  ObjectCache &operator=(ObjectCache const &) = delete;
+
+  VkShaderModule acquire(VkShaderModuleCreateInfo const &info);
+  VkDescriptorSetLayout acquire(VkDescriptorSetLayoutCreateInfo const &info);
+  VkPipelineLayout acquire(VkPipelineLayoutCreateInfo const &info);
+  VkRenderPass acquire(VkRenderPassCreateInfo const &info);
+  VkSampler acquire(VkSamplerCreateInfo const &info);
+  // Pipelines missing from the cache are created with a single call
+  std::vector<VkPipeline> acquire(VkGraphicsPipelineCreateInfo const *infos,
+                                  uint32_t count,
+                                  VkPipelineCache pipelineCache);
+  std::vector<VkPipeline> acquire(VkComputePipelineCreateInfo const *infos,
+                                  uint32_t count,
+                                  VkPipelineCache pipelineCache);
+
+  // VK_NULL_HANDLE is ignored
+  void release(VkShaderModule shaderModule);
+  void release(VkDescriptorSetLayout setLayout);
+  void release(VkPipelineLayout pipelineLayout);
+  void release(VkRenderPass renderPass);
+  void release(VkSampler sampler);
+  void release(VkPipeline pipeline);
+
+  Statistics statistics() const;
+  void writeStatistics(std::ostream &stream) const;
+
+private:
+  struct Entry {
+    std::string key;
+    uint32_t references = 0;
+    // Cached objects this one was keyed on, and holds a reference to
+    std::vector<std::pair<Type, uint64_t>> dependencies;
+  };
+
+  using EntryKey = std::pair<Type, uint64_t>;
+  struct EntryKeyHash {
+    size_t operator()(EntryKey const &key) const;
+  };
+
+  // Returns the handle cached under `key` with a reference added, or zero
+  // after counting a miss
+  uint64_t find(Type type, std::string const &key);
+  // Adds a freshly created object, keyed on `dependencies`. When another
+  // thread added the same key in the meantime, destroys `handle` and returns
+  // the cached one instead.
+  uint64_t insert(Type type, std::string key,
+                  std::vector<std::pair<Type, uint64_t>> const &dependencies,
+                  uint64_t handle);
+  void releaseHandle(Type type, uint64_t handle);
+  // Expects the lock to be held
+  void releaseLocked(Type type, uint64_t handle);
+  void destroy(Type type, uint64_t handle);
+
+  template <typename Info, typename Create>
+  std::vector<VkPipeline> acquirePipelines(Info const *infos, uint32_t count,
+                                           Create const &create);
+  template <typename Handle, typename Info, typename Create>
+  Handle acquireObject(Type type, Info const &info, Create const &create);
+
+  VkDevice m_device;
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<std::string, uint64_t> m_handles;
+  std::unordered_map<EntryKey, Entry, EntryKeyHash> m_entries;
+  Statistics m_statistics;
+};
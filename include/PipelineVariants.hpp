@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ObjectCache.hpp"
+#include "ThreadPool.hpp"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Specialized variants of a graphics pipeline, compiled in the background so
+// the first frame to need one doesn't stall on it. Until a variant is ready,
+// its handle hands out the generic pipeline, which is the one built from a
+// default Key.
+//
+// Variants differ in specialization constants and a few pieces of fixed
+// function state. Newly requested keys are split into one batch per worker
+// thread, and each batch is compiled with a single vkCreateGraphicsPipelines
+// call.
+class PipelineVariants {
+  struct Entry;
+
+public:
+  struct Key {
+    // Specialization constant `constant_id = i` takes constants[i]; empty
+    // keeps the defaults in the shaders
+    std::vector<uint32_t> constants;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+
+    bool operator==(Key const &other) const;
+    bool operator!=(Key const &other) const { return !(*this == other); }
+  };
+
+  // Returns one pipeline per key, in order, acquired from the ObjectCache;
+  // called on the worker threads
+  using BuildFunction =
+      std::function<std::vector<VkPipeline>(std::vector<Key> const &keys)>;
+
+  class Handle {
+  public:
+    Handle() = default;
+
+    // The variant once compiled, otherwise the generic pipeline
+    VkPipeline pipeline() const;
+    // False while compiling; a variant that failed to compile is ready and
+    // stays on the generic pipeline
+    bool ready() const;
+
+  private:
+    friend class PipelineVariants;
+
+    std::shared_ptr<Entry const> m_entry;
+    VkPipeline m_fallback = VK_NULL_HANDLE;
+  };
+
+  // `generic` stays owned by the caller
+  PipelineVariants(ObjectCache &objects, ThreadPool &threads,
+                   BuildFunction build, VkPipeline generic);
+  // Waits for batches still compiling
+  ~PipelineVariants();
+
+  PipelineVariants(PipelineVariants const &) = delete;
+  PipelineVariants &operator=(PipelineVariants const &) = delete;
+
+  // Queues the keys not requested before and returns a handle per key
+  std::vector<Handle> request(std::vector<Key> const &keys);
+  Handle request(Key const &key) { return request(std::vector<Key>{key})[0]; }
+
+  // Whether any variant finished since the last call, so that command buffers
+  // recorded with the generic pipeline can be recorded again
+  bool takeFinished() { return m_finished.exchange(false); }
+
+private:
+  struct Entry {
+    std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+    std::atomic<bool> done{false};
+  };
+
+  struct KeyHash {
+    size_t operator()(Key const &key) const;
+  };
+
+  void compile(std::vector<Key> keys,
+               std::vector<std::shared_ptr<Entry>> entries);
+
+  ObjectCache &m_objects;
+  ThreadPool &m_threads;
+  BuildFunction m_build;
+  VkPipeline m_generic;
+
+  std::unordered_map<Key, std::shared_ptr<Entry>, KeyHash> m_entries;
+  std::vector<std::future<void>> m_batches;
+  std::atomic<bool> m_finished{false};
+};
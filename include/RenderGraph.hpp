@@ -0,0 +1,226 @@
+#pragma once
+
+#include "MemoryAllocator.hpp"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The passes of a frame and the images they read and write. Passes are
+// declared in the order they run; compile() then
+//  - culls passes whose writes nothing later reads, unless they have side
+//    effects or write an imported image,
+//  - works out the layout transitions and the barriers between passes,
+//    merged into one vkCmdPipelineBarrier per pass and skipped where the
+//    previous access already covers the next one,
+//  - creates the transient images and places those whose lifetimes don't
+//    overlap on the same memory.
+// The result is recorded as often as needed with execute(), and can be
+// inspected through schedule() and writeSchedule().
+//
+// Imported images live outside the graph, e.g. the swapchain images or the
+// depth buffer that is kept between frames. Their state around the graph is
+// given on import: `before` names the layout they come in and the stages and
+// accesses they were last handed to, by a barrier or a semaphore wait;
+// `after` the layout to leave them in and the stages and accesses that
+// consume them next. Passes run in the order they are declared.
+//
+// Buffers are synchronized by the passes that own them.
+class RenderGraph {
+public:
+  using ResourceId = uint32_t;
+
+  enum class Usage {
+    ColorAttachment,
+    // Depth testing, and depth writes when written
+    DepthAttachment,
+    FragmentSampled,
+    ComputeSampled,
+    ComputeStorage,
+    TransferSource,
+    TransferDestination,
+  };
+
+  struct ImageState {
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+  };
+
+  struct ImageDescription {
+    VkFormat format;
+    VkExtent2D extent;
+  };
+
+  class PassBuilder {
+  public:
+    void read(ResourceId image, Usage usage);
+    void write(ResourceId image, Usage usage);
+    // Keeps the pass even if nothing reads what it writes
+    void sideEffects();
+
+  private:
+    friend class RenderGraph;
+    PassBuilder(RenderGraph &graph, uint32_t pass);
+
+    RenderGraph &m_graph;
+    uint32_t m_pass;
+  };
+
+  // `imageIndex` is the one given to execute()
+  using RecordFunction =
+      std::function<void(VkCommandBuffer commandBuffer, uint32_t imageIndex)>;
+  using PassHook = std::function<void(VkCommandBuffer commandBuffer,
+                                      std::string const &pass)>;
+
+  struct ScheduledBarrier {
+    std::string image;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+    VkAccessFlags srcAccess;
+    VkAccessFlags dstAccess;
+  };
+
+  // Barriers recorded ahead of a pass; the last entry, named "end", holds the
+  // transitions of imported images to their `after` state
+  struct ScheduledPass {
+    std::string name;
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    std::vector<ScheduledBarrier> barriers;
+  };
+
+  struct TransientImage {
+    std::string name;
+    // Images on the same memory range share a slot
+    uint32_t slot;
+    VkDeviceSize size;
+    // Positions in the schedule of the first and last passes using it
+    uint32_t firstPass;
+    uint32_t lastPass;
+  };
+
+  RenderGraph(VkDevice device, MemoryAllocator &allocator);
+  ~RenderGraph();
+
+  RenderGraph(RenderGraph const &) = delete;
+  RenderGraph &operator=(RenderGraph const &) = delete;
+
+  // One image per swapchain image, picked by the index given to execute(), or
+  // a single image used whatever the index
+  ResourceId importImage(std::string name, std::vector<VkImage> images,
+                         std::vector<VkImageView> views, VkFormat format,
+                         ImageState before, ImageState after);
+  // Created by compile(); its contents don't outlive the frame
+  ResourceId createImage(std::string name, ImageDescription description);
+
+  void addPass(std::string name,
+               std::function<void(PassBuilder &builder)> const &setup,
+               RecordFunction record);
+
+  // Call once after declaring everything
+  void compile();
+
+  // Records the passes kept by compile() with their barriers. The hooks are
+  // called around each pass, after its barriers.
+  void execute(VkCommandBuffer commandBuffer, uint32_t imageIndex,
+               PassHook const &beforePass = {},
+               PassHook const &afterPass = {}) const;
+
+  // For the record functions of passes
+  VkImage image(ResourceId image, uint32_t imageIndex) const;
+  VkImageView view(ResourceId image, uint32_t imageIndex) const;
+
+  std::vector<ScheduledPass> const &schedule() const;
+  std::vector<std::string> const &culledPasses() const;
+  std::vector<TransientImage> transientImages() const;
+  void writeSchedule(std::ostream &stream) const;
+
+private:
+  struct Use {
+    ResourceId image;
+    Usage usage;
+    bool write;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<Use> uses;
+    bool sideEffects = false;
+    RecordFunction record;
+  };
+
+  struct Image {
+    std::string name;
+    VkFormat format;
+    VkImageAspectFlags aspect;
+    bool imported;
+    std::vector<VkImage> images;
+    std::vector<VkImageView> views;
+    ImageState before;
+    ImageState after;
+    // Transient only
+    VkExtent2D extent{};
+    VkImageUsageFlags usage = 0;
+    VkMemoryRequirements requirements{};
+    uint32_t slot = 0;
+    uint32_t firstPass = UINT32_MAX;
+    uint32_t lastPass = 0;
+  };
+
+  // What the graph knows of an image between passes
+  struct Tracked {
+    VkImageLayout layout;
+    // Stages of the last write, or of the last layout transition, that later
+    // accesses chain on to; writes still to be made available
+    VkPipelineStageFlags writeStages;
+    VkAccessFlags writeAccess;
+    // Reads since then that later writes must wait for
+    VkPipelineStageFlags readStages = 0;
+    // Where the last write has been made visible
+    VkPipelineStageFlags visibleStages = 0;
+    VkAccessFlags visibleAccess = 0;
+  };
+
+  struct Barrier {
+    ResourceId image;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+    VkAccessFlags srcAccess;
+    VkAccessFlags dstAccess;
+  };
+
+  struct Step {
+    // Index into m_passes, or UINT32_MAX for the final transitions
+    uint32_t pass;
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    std::vector<Barrier> barriers;
+  };
+
+  void cullPasses();
+  void allocateTransientImages();
+  void planBarriers();
+  void addTransition(Step &step, ResourceId image, Tracked &tracked,
+                     ImageState const &next, bool write);
+  void recordBarriers(VkCommandBuffer commandBuffer, Step const &step,
+                      uint32_t imageIndex) const;
+
+  VkDevice m_device;
+  MemoryAllocator &m_allocator;
+  std::vector<Image> m_images;
+  std::vector<Pass> m_passes;
+  bool m_compiled = false;
+
+  // Filled in by compile()
+  std::vector<uint32_t> m_order;
+  std::vector<Step> m_steps;
+  std::vector<ScheduledPass> m_schedule;
+  std::vector<std::string> m_culledPasses;
+  std::vector<MemoryAllocator::Allocation> m_slotAllocations;
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum class RecordMode {
+  // Re-record one command buffer per frame in flight every frame
+  PerFrame,
+  // Record one command buffer per swapchain image, re-recorded only when dirty
+  Prerecorded,
+  // Split draws across worker threads recording secondary command buffers;
+  // DrawPath::Direct only
+  Parallel,
+};
+
+enum class DrawPath {
+  // One vkCmdDraw per draw, issued from the CPU
+  Direct,
+  // Instanced scene drawn from GPU buffers with indirect commands
+  Indirect,
+};
+
+enum class CullMode {
+  // Draw every instance
+  Off,
+  // Drop instances outside the view in a compute pass
+  Frustum,
+  // Also drop instances hidden behind the previous frame's depth
+  Occlusion,
+};
+
+enum class PresentMode {
+  // Present right away, tearing if the display is mid-scanout
+  Immediate,
+  // Replace the queued image at each vertical blank, without tearing or
+  // blocking
+  Mailbox,
+  // Queue images for vertical blanks, blocking when the queue is full
+  Fifo,
+  // Like Fifo, but present right away when a vertical blank was missed
+  FifoRelaxed,
+};
+
+enum class ValidationLevel {
+  Verbose,
+  Info,
+  Warning,
+  Error,
+};
+
+struct Settings {
+  // GPU to render on, by index in enumeration order or by part of its name;
+  // empty picks the most capable one
+  std::string device;
+  // Rank GPUs by a short copy benchmark, cached per device, ahead of their
+  // type and memory size
+  bool benchmarkDevices = false;
+  // Where benchmark results persist between runs; empty disables it
+  std::string deviceBenchmarkCachePath = "device_benchmark.txt";
+
+  // How many frames the CPU may record ahead of the GPU
+  uint32_t framesInFlight = 2;
+  RecordMode recordMode = RecordMode::PerFrame;
+  // Worker threads for RecordMode::Parallel; zero uses every hardware thread
+  uint32_t recordThreads = 0;
+  // Times the scene is drawn per frame, to stress command recording
+  uint32_t drawCount = 1;
+  DrawPath drawPath = DrawPath::Direct;
+  // Instances in the scene of DrawPath::Indirect
+  uint32_t instanceCount = 1;
+  // GPU culling of the instanced scene; anything but Off needs
+  // DrawPath::Indirect
+  CullMode cullMode = CullMode::Off;
+  // Run culling on an async compute queue when the device has one, writing
+  // the scene output of its frame while earlier frames still draw. Occlusion
+  // culling reads the previous frame's depth, so it overlaps less.
+  bool asyncCompute = true;
+  // Synchronize queues on timeline semaphores when the device supports them.
+  // Without them each submission gets a fence and async compute is off.
+  bool timelineSemaphores = true;
+  // Render through VK_KHR_dynamic_rendering when the device supports it,
+  // instead of a render pass and a framebuffer per swapchain image
+  bool dynamicRendering = true;
+  // Reach resources through one global descriptor set indexed from push
+  // constants when the device supports descriptor indexing, instead of
+  // binding descriptor sets per scene
+  bool bindless = true;
+  // Darken fragments with depth. Compiled as a specialized pipeline in the
+  // background, drawing with the generic one until it's ready.
+  bool depthShading = false;
+  // Scale of the view around the origin of the scene. Above 1 part of the
+  // scene falls outside the view and is frustum culled.
+  float zoom = 1.0f;
+
+  // Falls back to Fifo when the surface doesn't support it
+  PresentMode presentMode = PresentMode::Mailbox;
+  // Frames per second the CPU is held to; zero leaves it unlimited
+  double frameRateLimit = 0.0;
+
+  // Render into offscreen images without a window, surface or swapchain
+  bool headless = false;
+  // Number of frames rendered before a headless run exits
+  uint32_t headlessFrameCount = 1000;
+  uint32_t width = 640;
+  uint32_t height = 480;
+
+  // Time every pass on the GPU with timestamp and pipeline-statistics queries
+  bool profile = false;
+  // Write the passes, barriers and transient images of the frame's render
+  // graph to stdout whenever it is compiled
+  bool printRenderGraph = false;
+  // Written at exit; JSON when the name ends in .json, CSV otherwise
+  std::string profileOutput;
+  // Time taken by each startup step and to the first frame, in the same
+  // formats
+  std::string startupProfileOutput;
+
+  // Shaders found here as <name>.spv, e.g. Basic.vert.spv, replace the ones
+  // embedded at build time; empty uses the embedded ones only
+  std::string shaderDirectory;
+
+  // Shader sources watched for changes, which are recompiled into
+  // shaderDirectory and swapped in without restarting; empty disables it
+  std::string shaderSourceDirectory;
+
+  // Pipeline cache persisted between runs; empty disables it
+  std::string pipelineCachePath = "pipeline_cache.bin";
+
+  // Least severe validation message reported in debug builds
+  ValidationLevel validationLevel = ValidationLevel::Warning;
+  // Report the validation layer's performance warnings too
+  bool validationPerformance = true;
+  // Validation messages are written here instead of stderr
+  std::string validationOutput;
+};
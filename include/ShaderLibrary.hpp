@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Utils.hpp"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// SPIR-V of the shaders in shaders/, compiled and embedded into the binary at
+// build time, so loading a shader needs no file I/O.
+//
+// When an override directory is given and holds <name>.spv, that file is used
+// instead of the embedded copy, which allows iterating on a shader without
+// rebuilding.
+namespace ShaderLibrary {
+
+// SPIR-V words of a shader, pointing either into the binary or into a mapped
+// override file that is kept alive alongside
+struct Code {
+  uint32_t const *words = nullptr;
+  size_t wordCount = 0;
+  std::optional<Utils::MappedFile> file;
+};
+
+// `name` is the source file name, e.g. "Basic.vert"
+Code load(std::string const &name, std::string const &overrideDirectory = {});
+
+// Valid as long as `code`
+VkShaderModuleCreateInfo moduleInfo(Code const &code);
+
+} // namespace ShaderLibrary
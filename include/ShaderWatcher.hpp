@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Watches a directory of GLSL sources and recompiles the ones that change
+// into <outputDirectory>/<name>.spv, where ShaderLibrary picks them up as
+// overrides of the embedded shaders. Watching and compiling happen on a
+// thread of its own.
+//
+// Relies on inotify, so constructing one fails on anything but Linux.
+class ShaderWatcher {
+public:
+  // Called on the watcher thread with the name of every shader that compiled,
+  // e.g. "Basic.frag"
+  using ChangeFunction = std::function<void(std::string const &name)>;
+
+  // An empty `outputDirectory` uses a temporary directory that is removed
+  // again on destruction
+  ShaderWatcher(std::string sourceDirectory, std::string outputDirectory,
+                ChangeFunction onChange);
+  ~ShaderWatcher();
+
+  ShaderWatcher(ShaderWatcher const &) = delete;
+  ShaderWatcher &operator=(ShaderWatcher const &) = delete;
+
+  std::string const &outputDirectory() const { return m_outputDirectory; }
+
+private:
+  void watchLoop();
+  bool compile(std::string const &name) const;
+
+  std::string m_sourceDirectory;
+  std::string m_outputDirectory;
+  bool m_ownsOutputDirectory = false;
+  ChangeFunction m_onChange;
+
+  int m_inotify = -1;
+  std::atomic<bool> m_stopping{false};
+  std::thread m_thread;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Wall-clock breakdown of startup: how long each initialization step held up
+// the main thread, and how long it took until the first frame was submitted.
+// A step that only starts background work is short; waiting for that work
+// shows up in the step that needs its result.
+class StartupProfile {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Starts the clock that time to first frame is measured on
+  StartupProfile();
+
+  void record(std::string name, Clock::duration duration);
+  // Only the first call counts
+  void markFirstFrame();
+
+  void writeSummary(std::ostream &stream) const;
+  void writeJson(std::ostream &stream) const;
+  void writeCsv(std::ostream &stream) const;
+
+private:
+  struct Step {
+    std::string name;
+    // Since the clock started
+    double startMs;
+    double durationMs;
+  };
+
+  static double milliseconds(Clock::duration duration);
+
+  Clock::time_point m_start;
+  std::vector<Step> m_steps;
+  std::optional<double> m_firstFrameMs;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks from a shared queue
+class ThreadPool {
+public:
+  // Zero picks one thread per hardware thread
+  explicit ThreadPool(size_t threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  size_t size() const;
+
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F &&function) {
+    using Result = std::invoke_result_t<F>;
+
+    auto task = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<F>(function));
+    std::future<Result> future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.emplace([task]() { (*task)(); });
+    }
+    m_condition.notify_one();
+    return future;
+  }
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> m_workers;
+  std::queue<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stopping = false;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Submissions to one queue, numbered in order. Each submission returns a
+// point that the CPU can wait on or poll, and that submissions to other
+// queues can wait on; point 0 is complete from the start.
+//
+// With timeline semaphores, Vulkan 1.2 or VK_KHR_timeline_semaphore, every
+// submission signals the next value of a single semaphore. Otherwise every
+// submission gets a fence from a pool. A fence also covers the submissions
+// before it on the queue, so the fences retire in order. Another queue can't
+// wait on a fence, so in that mode a wait on a point of another queue blocks
+// the CPU until the point is reached, and a wait on a point of the same queue
+// is dropped as submission order already covers it.
+//
+// Not thread-safe; all calls belong on the render thread.
+class Timeline {
+public:
+  struct Wait {
+    Timeline *timeline;
+    uint64_t point;
+    VkPipelineStageFlags stages;
+  };
+
+  struct Submission {
+    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<Wait> waits;
+    // Binary semaphores, such as those of swapchain images
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    std::vector<VkSemaphore> signalSemaphores;
+  };
+
+  // `timelineSemaphores` has to match the feature enabled on `device`
+  Timeline(VkDevice device, VkQueue queue, bool timelineSemaphores);
+  ~Timeline();
+
+  Timeline(Timeline const &) = delete;
+  Timeline &operator=(Timeline const &) = delete;
+
+  // Returns the point the submission signals
+  uint64_t submit(Submission const &submission);
+
+  uint64_t lastSubmitted() const;
+  // Latest point the queue has reached
+  uint64_t completedPoint();
+  bool isComplete(uint64_t point);
+  void wait(uint64_t point);
+  void waitIdle();
+
+  bool usesTimelineSemaphore() const;
+
+private:
+  struct PendingFence {
+    uint64_t point;
+    VkFence fence;
+  };
+
+  // Fallback only: recycles the oldest `count` pending fences
+  void retireFences(size_t count);
+
+  VkDevice m_device;
+  VkQueue m_queue;
+  VkSemaphore m_semaphore = VK_NULL_HANDLE;
+  PFN_vkWaitSemaphoresKHR m_waitSemaphores = nullptr;
+  PFN_vkGetSemaphoreCounterValueKHR m_getSemaphoreCounterValue = nullptr;
+  uint64_t m_lastSubmitted = 0;
+  uint64_t m_completed = 0;
+  // Fallback only, oldest first
+  std::deque<PendingFence> m_pendingFences;
+  std::vector<VkFence> m_freeFences;
+};
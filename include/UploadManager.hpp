@@ -0,0 +1,113 @@
+#pragma once
+
+#include "MemoryAllocator.hpp"
+#include "Timeline.hpp"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Streams buffer and image data to the GPU through a persistently mapped
+// staging ring buffer.
+//
+// Uploads are batched into one command buffer and submitted together on the
+// transfer queue. With a dedicated transfer family each batch releases its
+// resources, and once the transfer has completed the acquiring half of the
+// ownership transfer is submitted on the graphics queue. Graphics work
+// therefore never waits on a transfer that is still running.
+//
+// Not thread-safe. update() submits to the graphics queue, so all calls belong
+// on the render thread.
+class UploadManager {
+public:
+  // Without a dedicated transfer queue both timelines are the graphics one
+  UploadManager(VkDevice device, MemoryAllocator &allocator,
+                uint32_t transferFamily, Timeline &transferTimeline,
+                uint32_t graphicsFamily, Timeline &graphicsTimeline,
+                VkDeviceSize ringSize = 32ull << 20);
+  ~UploadManager();
+
+  UploadManager(UploadManager const &) = delete;
+  UploadManager &operator=(UploadManager const &) = delete;
+
+  // Large buffer uploads are split across batches when they do not fit the
+  // ring in one piece. Buffers created with VK_SHARING_MODE_CONCURRENT, which
+  // have to include the transfer family, are `concurrent`: they skip the
+  // ownership transfer and are only ordered against the graphics queue.
+  void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, void const *data,
+                    VkDeviceSize size, bool concurrent = false);
+  // Uploads mip level 0 of a single layer color image and leaves it in
+  // `finalLayout`. The whole image has to fit the ring.
+  void uploadImage(VkImage image, VkExtent3D extent, void const *data,
+                   VkDeviceSize size, VkImageLayout finalLayout);
+
+  // Submits the uploads recorded so far and returns a ticket for them
+  uint64_t flush();
+  // Submits pending ownership acquires and retires finished batches. Call
+  // once per frame, before the frame's own submission.
+  void update();
+  // True once the uploads of `ticket` are usable on the graphics queue
+  bool isComplete(uint64_t ticket) const;
+  void waitIdle();
+
+  bool dedicatedTransferQueue() const;
+  uint32_t transferFamily() const;
+
+private:
+  enum class BatchState { Free, Recording, Transferring, Acquiring };
+
+  struct Batch {
+    BatchState state = BatchState::Free;
+    uint64_t ticket = 0;
+    VkCommandPool transferPool = VK_NULL_HANDLE;
+    VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+    VkCommandPool acquirePool = VK_NULL_HANDLE;
+    VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+    uint64_t transferPoint = 0;
+    uint64_t acquirePoint = 0;
+    // Ring offset just past the staging data of this batch, and the bytes it
+    // holds including alignment padding and space skipped when wrapping
+    VkDeviceSize ringEnd = 0;
+    VkDeviceSize ringBytes = 0;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkBufferMemoryBarrier> concurrentBufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+  };
+
+  static constexpr size_t batchCount = 4;
+
+  Batch &recordingBatch();
+  // Reserves `size` bytes of the ring, flushing and retiring batches until
+  // there is room
+  VkDeviceSize reserve(VkDeviceSize size, VkDeviceSize alignment);
+  void submitAcquire(Batch &batch);
+  // Retires submitted batches in order. With `wait` the oldest one is waited
+  // for, otherwise only batches that have already finished are retired.
+  void retire(bool wait);
+
+  VkDevice m_device;
+  MemoryAllocator &m_allocator;
+  uint32_t m_transferFamily;
+  Timeline &m_transferTimeline;
+  uint32_t m_graphicsFamily;
+  Timeline &m_graphicsTimeline;
+
+  VkBuffer m_ring = VK_NULL_HANDLE;
+  MemoryAllocator::Allocation m_ringAllocation;
+  VkDeviceSize m_ringSize;
+  // Next free byte, oldest byte still in use, and bytes in use
+  VkDeviceSize m_ringHead = 0;
+  VkDeviceSize m_ringTail = 0;
+  VkDeviceSize m_ringUsed = 0;
+
+  std::array<Batch, batchCount> m_batches;
+  // Submitted batches, oldest first
+  std::deque<size_t> m_inFlight;
+  size_t m_recording = batchCount;
+  uint64_t m_nextTicket = 1;
+  uint64_t m_completedTicket = 0;
+};
@@ -1,46 +1,68 @@
 #pragma once
 
+#include <cstddef>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <optional>
-#include <sstream>
+#include <string>
+#include <string_view>
 #include <vector>
 
 namespace Utils {
 
-static std::optional<std::string> readText(std::string const &filename) {
-  std::ifstream stream(filename);
+// Read-only view of a whole file, memory-mapped where the platform allows it,
+// so its contents can be handed to Vulkan or copied into a staging buffer
+// without reading them into an intermediate heap buffer first. The mapping is
+// page-aligned and lives as long as the MappedFile.
+class MappedFile {
+public:
+  // Empty when the file can't be opened
+  static std::optional<MappedFile> open(std::string const &filename);
 
-  if (!stream) {
-    std::cerr << "Failed to open " << filename << std::endl;
-    return std::nullopt;
-  }
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+  ~MappedFile();
 
-  std::stringstream ss;
-  while (stream) {
-    std::string line;
-    std::getline(stream, line);
-    ss << line;
-  }
-  return ss.str();
-}
+  MappedFile(MappedFile const &) = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
 
-static std::optional<std::vector<char>>
-readByteCode(std::string const &filename) {
-  std::ifstream file(filename, std::ios::ate | std::ios::binary);
+  void const *data() const { return m_data; }
+  size_t size() const { return m_size; }
 
-  if (!file) {
-    std::cerr << "Failed to open " << filename << std::endl;
-    return std::nullopt;
+  // The contents as an array of T, such as uint32_t for SPIR-V; nullptr when
+  // the size is not a multiple of sizeof(T)
+  template <typename T> T const *as() const {
+    static_assert(alignof(T) <= 16, "Mappings are only page-aligned");
+    return m_size % sizeof(T) == 0 ? static_cast<T const *>(m_data) : nullptr;
   }
+  template <typename T> size_t count() const { return m_size / sizeof(T); }
 
-  size_t size = static_cast<size_t>(file.tellg());
-  std::vector<char> buffer(size);
-  file.seekg(0);
-  file.read(buffer.data(), buffer.size());
-  file.close();
+  std::string_view text() const {
+    return {static_cast<char const *>(m_data), m_size};
+  }
+
+private:
+  MappedFile() = default;
+  void release();
+
+  void const *m_data = nullptr;
+  size_t m_size = 0;
+  // Holds the contents where mapping isn't supported
+  std::vector<std::max_align_t> m_fallback;
+};
 
-  return buffer;
+static std::optional<std::string> readText(std::string const &filename) {
+  std::optional<MappedFile> file = MappedFile::open(filename);
+  if (!file)
+    return std::nullopt;
+  return std::string(file->text());
 }
 
+// Writes to a temporary file of its own, flushes it to disk and renames it
+// over the destination, so readers see either the old contents or the new
+// ones, never a partial file, even with several writers or after a crash
+bool writeFileAtomic(std::string const &filename, void const *data,
+                     size_t size);
+
 } // namespace Utils
\ No newline at end of file
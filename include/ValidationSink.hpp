@@ -0,0 +1,96 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Receives debug utils messages and writes them out on a thread of its own,
+// so the driver thread that reports a message only copies it into a slot of
+// a fixed ring buffer. Producers claim slots with a compare-and-swap and
+// never block; when the ring is full the message is dropped and counted.
+//
+// Messages outside the severity and type filter are rejected before being
+// copied. Each message ID is written in full the first time it's seen only;
+// repeats are counted and summarized on destruction.
+class ValidationSink {
+public:
+  // An empty `outputPath` writes to stderr
+  ValidationSink(VkDebugUtilsMessageSeverityFlagsEXT severities,
+                 VkDebugUtilsMessageTypeFlagsEXT types,
+                 std::string const &outputPath = {});
+  // Writes out what's still queued, then the repeat counts
+  ~ValidationSink();
+
+  ValidationSink(ValidationSink const &) = delete;
+  ValidationSink &operator=(ValidationSink const &) = delete;
+
+  // Can be changed at any time from any thread; only narrows what the
+  // messenger was created to report
+  void setFilter(VkDebugUtilsMessageSeverityFlagsEXT severities,
+                 VkDebugUtilsMessageTypeFlagsEXT types);
+
+  // Use as pfnUserCallback with the sink as pUserData
+  static VKAPI_ATTR VkBool32 VKAPI_CALL
+  callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+           VkDebugUtilsMessageTypeFlagsEXT type,
+           VkDebugUtilsMessengerCallbackDataEXT const *callbackData,
+           void *userData);
+
+private:
+  static constexpr size_t slotCount = 256;
+  // Longer messages are cut short
+  static constexpr size_t messageLength = 2048;
+  static constexpr size_t idNameLength = 96;
+
+  struct Slot {
+    // Equal to the position a producer may claim the slot at, or one past
+    // it once the message is written
+    std::atomic<size_t> sequence;
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+    VkDebugUtilsMessageTypeFlagsEXT type;
+    // Deduplication key: the message ID, or a hash of the text for messages
+    // without one
+    uint64_t key;
+    char idName[idNameLength];
+    char message[messageLength];
+  };
+
+  struct Repeats {
+    std::string idName;
+    uint64_t count = 0;
+  };
+
+  void push(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+            VkDebugUtilsMessageTypeFlagsEXT type,
+            VkDebugUtilsMessengerCallbackDataEXT const &data);
+  void drainLoop();
+  // Consumer only; returns whether anything was written
+  bool drain();
+  void write(Slot const &slot);
+
+  std::atomic<VkDebugUtilsMessageSeverityFlagsEXT> m_severities;
+  std::atomic<VkDebugUtilsMessageTypeFlagsEXT> m_types;
+
+  std::unique_ptr<Slot[]> m_slots;
+  std::atomic<size_t> m_enqueuePosition{0};
+  size_t m_dequeuePosition = 0;
+  std::atomic<uint64_t> m_dropped{0};
+  uint64_t m_droppedReported = 0;
+
+  std::ofstream m_file;
+  std::ostream *m_output;
+  // Consumer only
+  std::unordered_map<uint64_t, Repeats> m_seen;
+
+  std::atomic<bool> m_stopping{false};
+  std::thread m_thread;
+};
@@ -2,6 +2,11 @@
 
 layout (location = 0) out vec4 outColor;
 
+// Specialized by PipelineVariants; the generic pipeline keeps the default
+layout (constant_id = 0) const bool depthShading = false;
+
 void main() {
     outColor = vec4(1.0, 0.0, 0.0, 1.0);
+    if (depthShading)
+        outColor.rgb *= 1.0 - 0.75 * gl_FragCoord.z;
 }
\ No newline at end of file
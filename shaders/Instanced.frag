@@ -0,0 +1,14 @@
+#version 450
+
+layout (location = 0) in vec4 inColor;
+
+layout (location = 0) out vec4 outColor;
+
+// Specialized by PipelineVariants; the generic pipeline keeps the default
+layout (constant_id = 0) const bool depthShading = false;
+
+void main() {
+    outColor = inColor;
+    if (depthShading)
+        outColor.rgb *= 1.0 - 0.75 * gl_FragCoord.z;
+}
@@ -0,0 +1,38 @@
+#version 450
+
+struct Instance {
+    vec2 offset;
+    float scale;
+    float rotation;
+    float depth;
+    float radius;
+    uint color;
+    uint mesh;
+};
+
+layout (std430, set = 0, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout (std430, set = 0, binding = 1) readonly buffer Visible {
+    uint visible[];
+};
+
+layout (push_constant) uniform View {
+    vec2 center;
+    float zoom;
+} view;
+
+layout (location = 0) in vec2 inPosition;
+
+layout (location = 0) out vec4 outColor;
+
+void main() {
+    Instance instance = instances[visible[gl_InstanceIndex]];
+    float s = sin(instance.rotation);
+    float c = cos(instance.rotation);
+    vec2 position = mat2(c, s, -s, c) * inPosition * instance.scale;
+    gl_Position = vec4((position + instance.offset - view.center) * view.zoom,
+                       instance.depth, 1.0);
+    outColor = unpackUnorm4x8(instance.color);
+}
@@ -0,0 +1,46 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Instanced.vert reaching its buffers through the DescriptorHeap, by the
+// indices that come with the view
+
+struct Instance {
+    vec2 offset;
+    float scale;
+    float rotation;
+    float depth;
+    float radius;
+    uint color;
+    uint mesh;
+};
+
+// Both alias the heap's buffer array
+layout (std430, set = 0, binding = 0) readonly buffer Instances {
+    Instance instances[];
+} instanceBuffers[];
+
+layout (std430, set = 0, binding = 0) readonly buffer Visible {
+    uint visible[];
+} visibleBuffers[];
+
+layout (push_constant) uniform View {
+    vec2 center;
+    float zoom;
+    uint instanceBuffer;
+    uint visibleBuffer;
+} view;
+
+layout (location = 0) in vec2 inPosition;
+
+layout (location = 0) out vec4 outColor;
+
+void main() {
+    uint index = visibleBuffers[view.visibleBuffer].visible[gl_InstanceIndex];
+    Instance instance = instanceBuffers[view.instanceBuffer].instances[index];
+    float s = sin(instance.rotation);
+    float c = cos(instance.rotation);
+    vec2 position = mat2(c, s, -s, c) * inPosition * instance.scale;
+    gl_Position = vec4((position + instance.offset - view.center) * view.zoom,
+                       instance.depth, 1.0);
+    outColor = unpackUnorm4x8(instance.color);
+}
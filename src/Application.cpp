@@ -23,36 +23,113 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,
   }
 }
 
-Application::Application()
-    : m_window(640, 480, "Mmmmm"), m_physicalDevice(VK_NULL_HANDLE) {
-  if (!m_window.initialized()) {
+Application::Application(Settings const &settings)
+    : m_settings(settings), m_framePacer(settings.frameRateLimit),
+      m_physicalDevice(VK_NULL_HANDLE) {
+  if (m_settings.framesInFlight == 0) {
+    throw std::runtime_error("At least one frame in flight is required");
+  }
+
+  if (m_settings.headless) {
+    return;
+  }
+
+  m_window.emplace(m_settings.width, m_settings.height, "Mmmmm");
+  if (!m_window->initialized()) {
     throw std::runtime_error("Failed to create window");
   }
+  m_deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 }
 
 Application::~Application() { cleanup(); }
 
+// Steps are timed into m_startupProfile. Reading the pipeline cache, querying
+// devices and compiling the graphics pipeline run on m_pipelineThreads while
+// the main thread carries on with the steps that don't need their results.
 void Application::init() {
-  createVulkanInstance();
-  setupDebugMessenger();
-  createSurface();
-  pickPhysicalDevice();
-  createLogicalDevice();
-  createSwapchain();
-  createImageViews();
-  createRenderPass();
-  createGraphicsPipeline();
-  createFramebuffers();
-  createCommandPool();
-  createCommandBuffer();
-  createSyncObjects();
+  auto const step = [this](char const *name, void (Application::*create)()) {
+    StartupProfile::Clock::time_point const start =
+        StartupProfile::Clock::now();
+    (this->*create)();
+    m_startupProfile.record(name, StartupProfile::Clock::now() - start);
+  };
+
+  step("createWorkerThreads", &Application::createWorkerThreads);
+  step("loadPipelineCacheData", &Application::loadPipelineCacheData);
+  step("createVulkanInstance", &Application::createVulkanInstance);
+  step("setupDebugMessenger", &Application::setupDebugMessenger);
+  if (!m_settings.headless)
+    step("createSurface", &Application::createSurface);
+  step("pickPhysicalDevice", &Application::pickPhysicalDevice);
+  step("createLogicalDevice", &Application::createLogicalDevice);
+  step("createMemoryAllocator", &Application::createMemoryAllocator);
+  step("createObjectCache", &Application::createObjectCache);
+  step("createUploadManager", &Application::createUploadManager);
+  step("createDescriptorHeap", &Application::createDescriptorHeap);
+  step("createComputeScheduler", &Application::createComputeScheduler);
+  step("createCommandPool", &Application::createCommandPool);
+  if (m_settings.headless)
+    step("createOffscreenTargets", &Application::createOffscreenTargets);
+  else
+    step("createSwapchain", &Application::createSwapchain);
+  step("createImageViews", &Application::createImageViews);
+  step("createDepthResources", &Application::createDepthResources);
+  step("createRenderPass", &Application::createRenderPass);
+  step("createPipelineCache", &Application::createPipelineCache);
+  step("createScene", &Application::createScene);
+  // Points the shader directory at its output before any pipeline is built
+  step("createShaderWatcher", &Application::createShaderWatcher);
+  step("createGraphicsPipeline", &Application::createGraphicsPipeline);
+  step("createCullingPass", &Application::createCullingPass);
+  step("createFramebuffers", &Application::createFramebuffers);
+  step("createRenderGraph", &Application::createRenderGraph);
+  step("createCommandBuffers", &Application::createCommandBuffers);
+  step("createImageCommandBuffers", &Application::createImageCommandBuffers);
+  step("createWorkerCommandBuffers", &Application::createWorkerCommandBuffers);
+  step("createSyncObjects", &Application::createSyncObjects);
+  step("createProfiler", &Application::createProfiler);
+  step("finishGraphicsPipeline", &Application::finishGraphicsPipeline);
+  step("requestPipelineVariants", &Application::requestPipelineVariants);
 }
 
 void Application::run() {
-  while (!m_window.shouldClose()) {
+  if (m_settings.headless) {
+    runHeadless();
+    return;
+  }
+
+  while (!m_window->shouldClose()) {
+    // Paced before polling, so the frame starts from the freshest input
+    m_framePacer.beginFrame();
     glfwPollEvents();
     drawFrame();
   }
+
+  vkDeviceWaitIdle(m_device);
+  reportProfile();
+}
+
+void Application::runHeadless() {
+  auto const start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < m_settings.headlessFrameCount; i++) {
+    m_framePacer.beginFrame();
+    drawFrame();
+  }
+
+  vkDeviceWaitIdle(m_device);
+  reportProfile();
+
+  std::chrono::duration<double> const elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "Rendered " << m_settings.headlessFrameCount << " frames";
+  if (m_indirectScene) {
+    std::cout << " of " << m_indirectScene->instanceCount() << " instances";
+  }
+  std::cout << " in " << elapsed.count() << " s ("
+            << m_settings.headlessFrameCount / elapsed.count() << " fps), "
+            << m_recordingTime.count() * 1e6 / m_settings.headlessFrameCount
+            << " us recording per frame" << std::endl;
 }
 
 void Application::createVulkanInstance() {
@@ -66,7 +143,13 @@ void Application::createVulkanInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_1;
+  // 1.2 brings timeline semaphores into the core, but 1.1 still runs with
+  // the extension or the fence fallback
+  uint32_t loaderVersion = VK_API_VERSION_1_1;
+  vkEnumerateInstanceVersion(&loaderVersion);
+  m_apiVersion = loaderVersion >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2
+                                                     : VK_API_VERSION_1_1;
+  appInfo.apiVersion = m_apiVersion;
 
   VkInstanceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -78,6 +161,7 @@ void Application::createVulkanInstance() {
 
   VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
   if (m_enableValidationLayers) {
+    createValidationSink();
     createInfo.enabledLayerCount =
         static_cast<uint32_t>(m_validationLayers.size());
     createInfo.ppEnabledLayerNames = m_validationLayers.data();
@@ -93,17 +177,6 @@ void Application::createVulkanInstance() {
   if (vkCreateInstance(&createInfo, nullptr, &m_vulkanInstance) != VK_SUCCESS) {
     throw std::runtime_error("Failed to create vulkan instance");
   }
-
-  uint32_t extensionCount = 0;
-  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
-  std::vector<VkExtensionProperties> extensions(extensionCount);
-  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount,
-                                         extensions.data());
-
-  std::cout << "Available extensions: " << std::endl;
-  for (const auto &extension : extensions) {
-    std::cout << '\t' << extension.extensionName << std::endl;
-  }
 }
 
 void Application::setupDebugMessenger() {
@@ -120,14 +193,12 @@ void Application::setupDebugMessenger() {
 }
 
 void Application::createSurface() {
-  m_surface = m_window.createSurface(m_vulkanInstance);
+  m_surface = m_window->createSurface(m_vulkanInstance);
 }
 
 void Application::pickPhysicalDevice() {
-  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-
   uint32_t deviceCount = 0;
-  vkEnumeratePhysicalDeviceGroups(m_vulkanInstance, &deviceCount, nullptr);
+  vkEnumeratePhysicalDevices(m_vulkanInstance, &deviceCount, nullptr);
 
   if (deviceCount == 0) {
     throw std::runtime_error("No GPU with vulkan support");
@@ -137,78 +208,210 @@ void Application::pickPhysicalDevice() {
   vkEnumeratePhysicalDevices(m_vulkanInstance, &deviceCount,
                              physicalDevices.data());
 
-  if (const auto &mostSuitable =
-          mostSuitableDevice(physicalDevices, m_surface, m_deviceExtensions)) {
-    physicalDevice = *mostSuitable;
+  // Each device answers on its own, so they are queried side by side
+  std::vector<std::future<DeviceCapabilities>> queries;
+  for (VkPhysicalDevice physicalDevice : physicalDevices) {
+    queries.push_back(m_pipelineThreads->submit([this, physicalDevice]() {
+      return DeviceCapabilities::query(physicalDevice, m_surface,
+                                       m_apiVersion);
+    }));
+  }
+  std::vector<DeviceCapabilities> devices;
+  for (std::future<DeviceCapabilities> &query : queries) {
+    devices.push_back(query.get());
   }
 
-  if (physicalDevice == VK_NULL_HANDLE) {
+  std::optional<size_t> chosen;
+  if (!m_settings.device.empty()) {
+    chosen = requestedDevice(devices, m_settings.device);
+    if (!chosen) {
+      std::cerr << "Available GPUs:" << std::endl;
+      for (size_t i = 0; i < devices.size(); i++) {
+        std::cerr << "\t" << i << ": " << devices[i].properties.deviceName
+                  << std::endl;
+      }
+      throw std::runtime_error("No GPU matches " + m_settings.device);
+    }
+    if (!isDeviceSuitable(devices[*chosen], m_deviceExtensions)) {
+      throw std::runtime_error(
+          std::string(devices[*chosen].properties.deviceName) +
+          " can't run the renderer");
+    }
+  } else if (m_settings.benchmarkDevices) {
+    DeviceBenchmark benchmark(m_settings.deviceBenchmarkCachePath);
+    chosen = mostSuitableDevice(devices, m_deviceExtensions, &benchmark);
+    benchmark.save();
+  } else {
+    chosen = mostSuitableDevice(devices, m_deviceExtensions, nullptr);
+  }
+
+  if (!chosen) {
     throw std::runtime_error("No suitable GPU found");
   }
 
-  m_physicalDevice = physicalDevice;
+  m_deviceCapabilities = std::move(devices[*chosen]);
+  m_physicalDevice = m_deviceCapabilities.physicalDevice;
+  m_queueFamilies = findQueueFamilies(m_deviceCapabilities);
+  std::cout << "Using " << m_deviceCapabilities.properties.deviceName
+            << std::endl;
 }
 
 Application::QueueFamilyIndices
-Application::findQueueFamilies(VkPhysicalDevice physicalDevice,
-                               VkSurfaceKHR surface) {
+Application::findQueueFamilies(DeviceCapabilities const &device) {
   QueueFamilyIndices indices;
+  std::vector<VkQueueFamilyProperties> const &queueFamilies =
+      device.queueFamilies;
 
-  uint32_t queueFamilyCount = 0;
-  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
-                                           nullptr);
+  for (int i = 0; i < queueFamilies.size(); i++) {
+    VkQueueFlags const flags = queueFamilies[i].queueFlags;
+    if (!indices.transferFamily.has_value() &&
+        (flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+      indices.transferFamily = i;
+    if (!indices.computeFamily.has_value() && (flags & VK_QUEUE_COMPUTE_BIT) &&
+        !(flags & VK_QUEUE_GRAPHICS_BIT))
+      indices.computeFamily = i;
 
-  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
-                                           queueFamilies.data());
+    if (indices.isComplete())
+      continue;
 
-  for (int i = 0; i < queueFamilies.size(); i++) {
-    if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+    if (flags & VK_QUEUE_GRAPHICS_BIT)
       indices.graphicsFamily = i;
 
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface,
-                                         &presentSupport);
+    // Without a surface nothing is presented, so the graphics queue stands in
+    // for the present queue
+    bool const presentSupport = device.presentSupport.empty()
+                                    ? indices.graphicsFamily == i
+                                    : device.presentSupport[i];
 
     if (presentSupport)
       indices.presentFamily = i;
+  }
 
-    if (indices.isComplete())
-      break;
+  if (!indices.computeFamily.has_value() &&
+      indices.graphicsFamily.has_value() &&
+      queueFamilies[indices.graphicsFamily.value()].queueCount > 1) {
+    indices.computeFamily = indices.graphicsFamily;
+    indices.computeQueueIndex = 1;
   }
 
   return indices;
 }
 
 void Application::createLogicalDevice() {
-  QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice, m_surface);
+  QueueFamilyIndices const &indices = m_queueFamilies;
 
-  std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(),
-                                            indices.presentFamily.value()};
+  // Queues to create per family; only async compute may take a second queue
+  // of a family
+  std::map<uint32_t, uint32_t> queueCounts = {
+      {indices.graphicsFamily.value(), 1}, {indices.presentFamily.value(), 1}};
+  if (indices.transferFamily.has_value())
+    queueCounts[indices.transferFamily.value()] = 1;
+  if (indices.computeFamily.has_value())
+    queueCounts[indices.computeFamily.value()] = indices.computeQueueIndex + 1;
 
-  float queuePriority = 1.0f;
-  for (uint32_t queueFamily : uniqueQueueFamilies) {
+  std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+  float const queuePriorities[] = {1.0f, 1.0f};
+  for (auto const &[queueFamily, queueCount] : queueCounts) {
     VkDeviceQueueCreateInfo queueCreateInfo{};
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queueCreateInfo.queueFamilyIndex = queueFamily;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    queueCreateInfo.queueCount = queueCount;
+    queueCreateInfo.pQueuePriorities = queuePriorities;
 
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures const &supportedFeatures =
+      m_deviceCapabilities.features;
+
+  bool const indirect = m_settings.drawPath == DrawPath::Indirect;
+  if (indirect && !supportedFeatures.drawIndirectFirstInstance) {
+    throw std::runtime_error(
+        "Indirect drawing requires drawIndirectFirstInstance");
+  }
+
+  // In RecordMode::Parallel the profiler's statistics queries stay active
+  // around secondary command buffers, which then have to inherit them
+  bool const parallel = m_settings.recordMode == RecordMode::Parallel;
   VkPhysicalDeviceFeatures deviceFeatures{};
+  deviceFeatures.pipelineStatisticsQuery =
+      m_settings.profile && supportedFeatures.pipelineStatisticsQuery &&
+      (!parallel || supportedFeatures.inheritedQueries);
+  deviceFeatures.inheritedQueries =
+      parallel && deviceFeatures.pipelineStatisticsQuery;
+  deviceFeatures.multiDrawIndirect =
+      indirect && supportedFeatures.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance = indirect;
+
+  // The draw count can come from a GPU buffer when the extension is there
+  std::vector<char const *> extensions = m_deviceExtensions;
+  bool const drawIndirectCount =
+      indirect && m_deviceCapabilities.hasExtensions(
+                      {VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME});
+  if (drawIndirectCount)
+    extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+  bool const timelineSemaphores =
+      m_settings.timelineSemaphores && m_deviceCapabilities.timelineSemaphore;
+  if (timelineSemaphores &&
+      m_deviceCapabilities.apiVersion < VK_API_VERSION_1_2)
+    extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+  timelineFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+  timelineFeatures.timelineSemaphore = VK_TRUE;
+
+  bool const dynamicRendering =
+      m_settings.dynamicRendering && m_deviceCapabilities.dynamicRendering;
+  if (dynamicRendering)
+    extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+
+  bool const descriptorIndexing =
+      m_settings.bindless && m_deviceCapabilities.descriptorIndexing;
+  if (descriptorIndexing &&
+      m_deviceCapabilities.apiVersion < VK_API_VERSION_1_2)
+    extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  deviceFeatures.shaderStorageBufferArrayDynamicIndexing = descriptorIndexing;
+  deviceFeatures.shaderSampledImageArrayDynamicIndexing = descriptorIndexing;
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+  indexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+  indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+  indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+  indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+  void *featureChain = nullptr;
+  if (timelineSemaphores) {
+    timelineFeatures.pNext = featureChain;
+    featureChain = &timelineFeatures;
+  }
+  if (dynamicRendering) {
+    dynamicRenderingFeatures.pNext = featureChain;
+    featureChain = &dynamicRenderingFeatures;
+  }
+  if (descriptorIndexing) {
+    indexingFeatures.pNext = featureChain;
+    featureChain = &indexingFeatures;
+  }
+
   VkDeviceCreateInfo deviceCreateInfo{};
   deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  deviceCreateInfo.pNext = featureChain;
   deviceCreateInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
   deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
   deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
   deviceCreateInfo.enabledExtensionCount =
-      static_cast<uint32_t>(m_deviceExtensions.size());
-  deviceCreateInfo.ppEnabledExtensionNames = m_deviceExtensions.data();
+      static_cast<uint32_t>(extensions.size());
+  deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
   if (m_enableValidationLayers) {
     deviceCreateInfo.enabledLayerCount =
@@ -226,34 +429,122 @@ void Application::createLogicalDevice() {
 
   VkQueue graphicsQueue;
   VkQueue presentQueue;
+  VkQueue transferQueue;
   vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
   vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+  // Without a transfer-only family uploads share the graphics queue
+  uint32_t const transferFamily =
+      indices.transferFamily.value_or(indices.graphicsFamily.value());
+  vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
+  VkQueue computeQueue = VK_NULL_HANDLE;
+  if (indices.computeFamily.has_value()) {
+    vkGetDeviceQueue(device, indices.computeFamily.value(),
+                     indices.computeQueueIndex, &computeQueue);
+  }
+
+  if (drawIndirectCount) {
+    m_cmdDrawIndexedIndirectCount =
+        reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+  }
+  if (dynamicRendering) {
+    m_cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+    m_cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+  }
 
   m_device = device;
+  m_enabledFeatures = deviceFeatures;
+  m_timelineSemaphores = timelineSemaphores;
+  m_dynamicRendering = dynamicRendering;
+  m_descriptorIndexing = descriptorIndexing;
   m_graphicsQueue = graphicsQueue;
   m_presentQueue = presentQueue;
+  m_transferQueue = transferQueue;
+  m_computeQueue = computeQueue;
+  m_graphicsTimeline =
+      std::make_unique<Timeline>(m_device, m_graphicsQueue, timelineSemaphores);
+}
+
+void Application::createMemoryAllocator() {
+  m_allocator = std::make_unique<MemoryAllocator>(m_physicalDevice, m_device);
+}
+
+void Application::createObjectCache() {
+  m_objectCache = std::make_unique<ObjectCache>(m_device);
+}
+
+void Application::createUploadManager() {
+  QueueFamilyIndices const &indices = m_queueFamilies;
+  uint32_t const graphicsFamily = indices.graphicsFamily.value();
+
+  if (m_transferQueue != m_graphicsQueue) {
+    m_transferTimeline = std::make_unique<Timeline>(m_device, m_transferQueue,
+                                                    m_timelineSemaphores);
+  }
+  m_uploadManager = std::make_unique<UploadManager>(
+      m_device, *m_allocator, indices.transferFamily.value_or(graphicsFamily),
+      m_transferTimeline ? *m_transferTimeline : *m_graphicsTimeline,
+      graphicsFamily, *m_graphicsTimeline);
+}
+
+void Application::createDescriptorHeap() {
+  if (!m_descriptorIndexing)
+    return;
+
+  m_descriptorHeap = std::make_unique<DescriptorHeap>(
+      m_device, m_deviceCapabilities.descriptorIndexingProperties,
+      DescriptorHeap::Capacity{});
+}
+
+// Culling is the only compute work so far, so the queue is only used when
+// the scene is culled. Without timeline semaphores every compute submission
+// would wait on the CPU for the previous frame, so culling stays on the
+// graphics queue.
+void Application::createComputeScheduler() {
+  if (!m_settings.asyncCompute || m_computeQueue == VK_NULL_HANDLE ||
+      !m_timelineSemaphores || m_settings.drawPath != DrawPath::Indirect ||
+      m_settings.cullMode == CullMode::Off)
+    return;
+
+  QueueFamilyIndices const &indices = m_queueFamilies;
+  uint32_t const graphicsFamily = indices.graphicsFamily.value();
+  uint32_t const computeFamily = indices.computeFamily.value();
+
+  m_computeTimeline =
+      std::make_unique<Timeline>(m_device, m_computeQueue, true);
+  m_computeScheduler = std::make_unique<ComputeScheduler>(
+      m_device, computeFamily, *m_computeTimeline, *m_graphicsTimeline,
+      m_settings.framesInFlight);
+  if (computeFamily != graphicsFamily)
+    m_computeSharingFamilies = {graphicsFamily, computeFamily};
 }
 
 void Application::createSwapchain() {
-  SwapchainSupportDetails swapchainSupport =
-      querySwapchainSupport(m_physicalDevice, m_surface);
+  // The current extent follows the window, unlike the rest of the snapshot
+  VkSurfaceCapabilitiesKHR capabilities;
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, m_surface,
+                                            &capabilities);
 
   VkSurfaceFormatKHR surfaceFormat =
-      chooseSwapSurfaceFormat(swapchainSupport.formats);
-  VkPresentModeKHR presentMode =
-      chooseSwapPresentMode(swapchainSupport.presentModes);
-  Size<int> framebufferSize = m_window.getFramebufferSize();
+      chooseSwapSurfaceFormat(m_deviceCapabilities.surfaceFormats);
+  VkPresentModeKHR presentMode = chooseSwapPresentMode(
+      m_deviceCapabilities.presentModes, m_settings.presentMode);
+  // Once, rather than on every resize
+  if (m_swapchain == VK_NULL_HANDLE &&
+      presentMode != toVkPresentMode(m_settings.presentMode))
+    std::cerr << "Requested present mode unsupported, using FIFO" << std::endl;
+  Size<int> framebufferSize = m_window->getFramebufferSize();
   VkExtent2D extent =
-      chooseSwapExtent(swapchainSupport.capabilities,
+      chooseSwapExtent(capabilities,
                        {static_cast<uint32_t>(framebufferSize.width),
                         static_cast<uint32_t>(framebufferSize.height)});
 
-  uint32_t imageCount =
-      swapchainSupport.capabilities.minImageCount +
-      ((swapchainSupport.capabilities.maxImageCount == 0 ||
-        imageCount < swapchainSupport.capabilities.maxImageCount)
-           ? 1
-           : 0);
+  uint32_t imageCount = capabilities.minImageCount + 1;
+  if (capabilities.maxImageCount != 0) {
+    imageCount = std::min(imageCount, capabilities.maxImageCount);
+  }
 
   VkSwapchainCreateInfoKHR createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -265,7 +556,7 @@ void Application::createSwapchain() {
   createInfo.imageArrayLayers = 1;
   createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-  QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice, m_surface);
+  QueueFamilyIndices const &indices = m_queueFamilies;
   uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(),
                                    indices.presentFamily.value()};
 
@@ -279,11 +570,13 @@ void Application::createSwapchain() {
     createInfo.pQueueFamilyIndices = nullptr;
   }
 
-  createInfo.preTransform = swapchainSupport.capabilities.currentTransform;
+  createInfo.preTransform = capabilities.currentTransform;
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // Lets the driver hand resources over and keeps presenting until the old
+  // swapchain is retired
+  createInfo.oldSwapchain = m_swapchain;
 
   VkSwapchainKHR swapchain;
   if (vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &swapchain) !=
@@ -301,6 +594,143 @@ void Application::createSwapchain() {
   m_swapchainExtent = extent;
 }
 
+// Builds a new swapchain next to the old one. Frames already in flight still
+// reference the old swapchain, image views and framebuffers, so those are
+// retired through deferred destruction instead of idling the device.
+void Application::recreateSwapchain() {
+  Size<int> framebufferSize = m_window->getFramebufferSize();
+  while (framebufferSize.width == 0 || framebufferSize.height == 0) {
+    if (m_window->shouldClose())
+      return;
+    glfwWaitEvents();
+    framebufferSize = m_window->getFramebufferSize();
+  }
+
+  VkSwapchainKHR oldSwapchain = m_swapchain;
+  std::vector<VkImageView> oldImageViews = std::move(m_swapchainImageViews);
+  std::vector<VkFramebuffer> oldFramebuffers =
+      std::move(m_swapchainFramebuffers);
+  m_swapchainImageViews.clear();
+  m_swapchainFramebuffers.clear();
+  VkImage oldDepthImage = m_depthImage;
+  VkImageView oldDepthImageView = m_depthImageView;
+  MemoryAllocator::Allocation oldDepthImageAllocation = m_depthImageAllocation;
+
+  createSwapchain();
+  createImageViews();
+  createDepthResources();
+  createFramebuffers();
+  if (m_cullingPass) {
+    m_cullingPass->resize(
+        m_depthImage, m_depthFormat, m_swapchainExtent,
+        [this](std::function<void()> destroy) {
+          deferDestruction(std::move(destroy));
+        });
+  }
+  // Frames in flight may still use its transient images
+  std::shared_ptr<RenderGraph> oldRenderGraph = std::move(m_renderGraph);
+  deferDestruction([oldRenderGraph]() mutable { oldRenderGraph.reset(); });
+  createRenderGraph();
+
+  deferDestruction([this, oldSwapchain, oldImageViews, oldFramebuffers,
+                    oldDepthImage, oldDepthImageView,
+                    oldDepthImageAllocation]() {
+    for (VkFramebuffer framebuffer : oldFramebuffers) {
+      vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+    }
+    for (VkImageView imageView : oldImageViews) {
+      vkDestroyImageView(m_device, imageView, nullptr);
+    }
+    vkDestroyImageView(m_device, oldDepthImageView, nullptr);
+    vkDestroyImage(m_device, oldDepthImage, nullptr);
+    m_allocator->free(oldDepthImageAllocation);
+    vkDestroySwapchainKHR(m_device, oldSwapchain, nullptr);
+  });
+
+  // Points of images that are still being rendered stay tracked so the next
+  // frame using that index waits for them
+  m_imagePoints.resize(m_swapchainImages.size(), 0);
+
+  if (m_settings.recordMode == RecordMode::Prerecorded &&
+      m_imageCommandBuffers.size() < m_swapchainImages.size()) {
+    std::vector<VkCommandBuffer> commandBuffers(
+        m_swapchainImages.size() - m_imageCommandBuffers.size());
+
+    VkCommandBufferAllocateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    info.commandPool = m_commandPool;
+    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    info.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+    if (vkAllocateCommandBuffers(m_device, &info, commandBuffers.data()) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate command buffers");
+    }
+    m_imageCommandBuffers.insert(m_imageCommandBuffers.end(),
+                                 commandBuffers.begin(), commandBuffers.end());
+
+    if (m_profiler) {
+      m_profiler->growSlots(
+          static_cast<uint32_t>(m_imageCommandBuffers.size()));
+    }
+  }
+
+  markCommandBuffersDirty();
+}
+
+void Application::deferDestruction(std::function<void()> destroy) {
+  m_deferredDestructions.push_back(
+      {m_graphicsTimeline->lastSubmitted(), std::move(destroy)});
+}
+
+// Destroys objects whose last use on the graphics queue has completed. Async
+// compute work is covered too, as every frame's graphics submission waits on
+// the compute submission of that frame.
+void Application::destroyRetiredObjects(bool all) {
+  while (!m_deferredDestructions.empty()) {
+    DeferredDestruction &front = m_deferredDestructions.front();
+    if (!all && !m_graphicsTimeline->isComplete(front.retiredAt))
+      break;
+    front.destroy();
+    m_deferredDestructions.pop_front();
+  }
+}
+
+void Application::createOffscreenTargets() {
+  VkFormat const format = VK_FORMAT_R8G8B8A8_UNORM;
+  VkExtent2D const extent = {m_settings.width, m_settings.height};
+
+  // One target per frame in flight, so a frame never waits on another
+  m_swapchainImages.resize(m_settings.framesInFlight);
+
+  for (uint32_t i = 0; i < m_settings.framesInFlight; i++) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(m_device, &imageInfo, nullptr, &m_swapchainImages[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("Failed to create offscreen image");
+    }
+
+    m_offscreenImageAllocations.push_back(m_allocator->allocateForImage(
+        m_swapchainImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+  }
+
+  m_swapchainImageFormat = format;
+  m_swapchainExtent = extent;
+}
+
 void Application::createImageViews() {
   m_swapchainImageViews.resize(m_swapchainImages.size());
 
@@ -327,7 +757,112 @@ void Application::createImageViews() {
   }
 }
 
+void Application::createDepthResources() {
+  m_depthFormat = findDepthFormat();
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = m_depthFormat;
+  imageInfo.extent = {m_swapchainExtent.width, m_swapchainExtent.height, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  // Occlusion culling on async compute reads it from the compute family
+  if (!m_computeSharingFamilies.empty()) {
+    imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    imageInfo.queueFamilyIndexCount =
+        static_cast<uint32_t>(m_computeSharingFamilies.size());
+    imageInfo.pQueueFamilyIndices = m_computeSharingFamilies.data();
+  } else {
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  }
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  if (vkCreateImage(m_device, &imageInfo, nullptr, &m_depthImage) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth image");
+  }
+  m_depthImageAllocation = m_allocator->allocateForImage(
+      m_depthImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (m_depthFormat != VK_FORMAT_D32_SFLOAT)
+    aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = m_depthImage;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = m_depthFormat;
+  viewInfo.subresourceRange = {aspectMask, 0, 1, 0, 1};
+
+  if (vkCreateImageView(m_device, &viewInfo, nullptr, &m_depthImageView) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth image view");
+  }
+
+  // Occlusion culling reads the previous frame's depth, so even the first
+  // frame needs a cleared buffer in the layout the render pass leaves behind.
+  // Culling on async compute waits for the clear along with the rest of the
+  // graphics work submitted before it.
+  submitOneTimeCommands([this, aspectMask](VkCommandBuffer commandBuffer) {
+    VkImageSubresourceRange const range = {aspectMask, 0, 1, 0, 1};
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_depthImage;
+    barrier.subresourceRange = range;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+
+    VkClearDepthStencilValue const clearValue = {1.0f, 0};
+    vkCmdClearDepthStencilImage(commandBuffer, m_depthImage,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                &clearValue, 1, &range);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &barrier);
+  });
+}
+
+// Prefers a format without stencil, which the scene never uses
+VkFormat Application::findDepthFormat() const {
+  VkFormatFeatureFlags const features =
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+  for (VkFormat format :
+       {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+        VK_FORMAT_D24_UNORM_S8_UINT}) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+    if ((properties.optimalTilingFeatures & features) == features)
+      return format;
+  }
+  throw std::runtime_error("Failed to find a supported depth format");
+}
+
 void Application::createRenderPass() {
+  if (m_dynamicRendering)
+    return;
+
   VkAttachmentDescription colorAttachments = [this]() {
     VkAttachmentDescription desc{};
     desc.format = m_swapchainImageFormat;
@@ -336,11 +871,26 @@ void Application::createRenderPass() {
     desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    desc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    desc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    desc.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    desc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     return desc;
   }();
 
+  VkAttachmentDescription depthAttachment = [this]() {
+    VkAttachmentDescription desc{};
+    desc.format = m_depthFormat;
+    desc.samples = VK_SAMPLE_COUNT_1_BIT;
+    desc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    desc.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    desc.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    return desc;
+  }();
+
+  VkAttachmentDescription attachments[] = {colorAttachments, depthAttachment};
+
   VkAttachmentReference colorAttachmentRef = []() {
     VkAttachmentReference ref{};
     ref.attachment = 0;
@@ -348,61 +898,178 @@ void Application::createRenderPass() {
     return ref;
   }();
 
-  VkSubpassDescription subpass = [&colorAttachmentRef]() {
+  VkAttachmentReference depthAttachmentRef = []() {
+    VkAttachmentReference ref{};
+    ref.attachment = 1;
+    ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    return ref;
+  }();
+
+  VkSubpassDescription subpass = [&colorAttachmentRef, &depthAttachmentRef]() {
     VkSubpassDescription desc{};
     desc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     desc.colorAttachmentCount = 1;
     desc.pColorAttachments = &colorAttachmentRef;
+    desc.pDepthStencilAttachment = &depthAttachmentRef;
     return desc;
   }();
 
-  VkSubpassDependency dependency = []() {
-    VkSubpassDependency dep{};
-    dep.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dep.dstSubpass = 0;
-    dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dep.srcAccessMask = 0;
-    dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    return dep;
-  }();
-
-  VkRenderPassCreateInfo renderPassInfo = [&colorAttachments, &subpass,
-                                           &dependency]() {
+  // Layout transitions and dependencies around the pass come from the render
+  // graph's barriers, so the attachments stay in the subpass's layouts
+  VkRenderPassCreateInfo renderPassInfo = [&attachments, &subpass]() {
     VkRenderPassCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    info.attachmentCount = 1;
-    info.pAttachments = &colorAttachments;
+    info.attachmentCount = 2;
+    info.pAttachments = attachments;
     info.subpassCount = 1;
     info.pSubpasses = &subpass;
-    info.dependencyCount = 1;
-    info.pDependencies = &dependency;
     return info;
   }();
 
-  VkRenderPass renderPass;
-  if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &renderPass) !=
+  m_renderPass = m_objectCache->acquire(renderPassInfo);
+}
+
+void Application::createWorkerThreads() {
+  m_pipelineThreads = std::make_unique<ThreadPool>();
+}
+
+// Maps the pipeline cache and faults its pages in on a worker thread, so that
+// createPipelineCache finds it in memory
+void Application::loadPipelineCacheData() {
+  std::string const path = m_settings.pipelineCachePath;
+  if (path.empty())
+    return;
+
+  m_pipelineCacheData = m_pipelineThreads->submit(
+      [path]() -> std::optional<Utils::MappedFile> {
+        if (!std::filesystem::exists(path))
+          return std::nullopt;
+        std::optional<Utils::MappedFile> file = Utils::MappedFile::open(path);
+        if (file) {
+          auto const *bytes = static_cast<unsigned char const *>(file->data());
+          unsigned char volatile sink = 0;
+          for (size_t offset = 0; offset < file->size(); offset += 4096) {
+            sink = sink + bytes[offset];
+          }
+        }
+        return file;
+      });
+}
+
+void Application::createPipelineCache() {
+  // Mapped only until the cache is created, which copies what it needs
+  std::optional<Utils::MappedFile> initialData;
+
+  if (m_pipelineCacheData.valid()) {
+    if (std::optional<Utils::MappedFile> file = m_pipelineCacheData.get()) {
+      if (isPipelineCacheCompatible(file->data(), file->size(),
+                                    m_deviceCapabilities.properties))
+        initialData = std::move(file);
+      else
+        std::cerr << "Ignoring pipeline cache from a different device or "
+                     "driver: "
+                  << m_settings.pipelineCachePath << std::endl;
+    }
+  }
+
+  VkPipelineCacheCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  info.initialDataSize = initialData ? initialData->size() : 0;
+  info.pInitialData = initialData ? initialData->data() : nullptr;
+
+  VkPipelineCache pipelineCache;
+  if (vkCreatePipelineCache(m_device, &info, nullptr, &pipelineCache) !=
       VK_SUCCESS) {
-    throw std::runtime_error("Failed to create render pass");
+    throw std::runtime_error("Failed to create pipeline cache");
   }
-  m_renderPass = renderPass;
+  m_pipelineCache = pipelineCache;
+}
+
+void Application::savePipelineCache() const {
+  if (m_pipelineCache == VK_NULL_HANDLE || m_settings.pipelineCachePath.empty())
+    return;
+
+  size_t size = 0;
+  if (vkGetPipelineCacheData(m_device, m_pipelineCache, &size, nullptr) !=
+      VK_SUCCESS) {
+    return;
+  }
+
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(m_device, m_pipelineCache, &size, data.data()) !=
+      VK_SUCCESS) {
+    return;
+  }
+  data.resize(size);
+
+  Utils::writeFileAtomic(m_settings.pipelineCachePath, data.data(),
+                         data.size());
 }
 
 void Application::createGraphicsPipeline() {
-  auto const readCode = [](std::string const &filename) {
-    std::optional<std::vector<char>> code = Utils::readByteCode(filename);
-    if (code)
-      return code.value();
-    else
-      throw std::runtime_error("Failed to get shader code");
-  };
-  std::vector<char> vertShaderCode = readCode("Basic.vert.spv");
-  std::vector<char> fragShaderCode = readCode("Basic.frag.spv");
+  std::vector<VkDescriptorSetLayout> setLayouts;
+  std::vector<VkPushConstantRange> pushConstantRanges;
+  if (m_descriptorHeap)
+    setLayouts.push_back(m_descriptorHeap->layout());
+  else if (m_indirectScene)
+    setLayouts.push_back(m_indirectScene->descriptorSetLayout());
+  if (m_indirectScene) {
+    pushConstantRanges.push_back({VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                  m_indirectScene->pushConstantSize()});
+  }
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = [&setLayouts,
+                                                   &pushConstantRanges]() {
+    VkPipelineLayoutCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    info.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    info.pSetLayouts = setLayouts.data();
+    info.pushConstantRangeCount =
+        static_cast<uint32_t>(pushConstantRanges.size());
+    info.pPushConstantRanges = pushConstantRanges.data();
+    return info;
+  }();
+
+  m_pipelineLayout = m_objectCache->acquire(pipelineLayoutInfo);
+
+  // Compiles while init carries on, until finishGraphicsPipeline
+  m_graphicsPipelineBuild = m_pipelineThreads->submit([this]() {
+    return buildGraphicsPipelines({PipelineVariants::Key{}})[0];
+  });
+}
+
+void Application::finishGraphicsPipeline() {
+  m_graphicsPipeline = m_graphicsPipelineBuild.get();
+  markCommandBuffersDirty();
+}
+
+// Variants of m_graphicsPipeline, which stands in for them until compiled
+void Application::requestPipelineVariants() {
+  m_pipelineVariants = std::make_unique<PipelineVariants>(
+      *m_objectCache, *m_pipelineThreads,
+      [this](std::vector<PipelineVariants::Key> const &keys) {
+        return buildGraphicsPipelines(keys);
+      },
+      m_graphicsPipeline);
+
+  PipelineVariants::Key key;
+  if (m_settings.depthShading)
+    key.constants = {VK_TRUE};
+  m_pipelineVariant = m_pipelineVariants->request(key);
+}
 
-  VkShaderModule vertShaderModule =
-      createShaderModule(vertShaderCode, m_device);
-  VkShaderModule fragShaderModule =
-      createShaderModule(fragShaderCode, m_device);
+// Acquires one pipeline per key from the object cache, creating the missing
+// ones with a single call. Only reads state that is fixed after init, so it
+// may run on another thread.
+std::vector<VkPipeline> Application::buildGraphicsPipelines(
+    std::vector<PipelineVariants::Key> const &keys) const {
+  std::array<std::string, 2> const shaders = graphicsShaders();
+  VkShaderModule vertShaderModule = m_objectCache->acquire(
+      ShaderLibrary::moduleInfo(
+          ShaderLibrary::load(shaders[0], m_settings.shaderDirectory)));
+  VkShaderModule fragShaderModule = m_objectCache->acquire(
+      ShaderLibrary::moduleInfo(
+          ShaderLibrary::load(shaders[1], m_settings.shaderDirectory)));
 
   VkPipelineShaderStageCreateInfo vertStageInfo{};
   vertStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -416,16 +1083,23 @@ void Application::createGraphicsPipeline() {
   fragStageInfo.module = fragShaderModule;
   fragStageInfo.pName = "main";
 
-  VkPipelineShaderStageCreateInfo shaderStages[] = {vertStageInfo,
-                                                    fragStageInfo};
+  std::vector<VkVertexInputBindingDescription> vertexBindings;
+  std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+  if (m_indirectScene) {
+    vertexBindings = IndirectScene::vertexBindings();
+    vertexAttributes = IndirectScene::vertexAttributes();
+  }
 
-  VkPipelineVertexInputStateCreateInfo vertInputInfo = []() {
+  VkPipelineVertexInputStateCreateInfo vertInputInfo = [&vertexBindings,
+                                                        &vertexAttributes]() {
     VkPipelineVertexInputStateCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    info.vertexBindingDescriptionCount = 0;
-    info.pVertexBindingDescriptions = nullptr;
-    info.vertexAttributeDescriptionCount = 0;
-    info.pVertexAttributeDescriptions = nullptr;
+    info.vertexBindingDescriptionCount =
+        static_cast<uint32_t>(vertexBindings.size());
+    info.pVertexBindingDescriptions = vertexBindings.data();
+    info.vertexAttributeDescriptionCount =
+        static_cast<uint32_t>(vertexAttributes.size());
+    info.pVertexAttributeDescriptions = vertexAttributes.data();
     return info;
   }();
 
@@ -437,26 +1111,14 @@ void Application::createGraphicsPipeline() {
     return info;
   }();
 
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = static_cast<float>(m_swapchainExtent.width);
-  viewport.height = static_cast<float>(m_swapchainExtent.height);
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = m_swapchainExtent;
-
-  VkPipelineViewportStateCreateInfo viewportStateInfo = [&viewport,
-                                                         &scissor]() {
+  // Viewport and scissor are dynamic so the pipeline survives a resize
+  VkPipelineViewportStateCreateInfo viewportStateInfo = []() {
     VkPipelineViewportStateCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     info.viewportCount = 1;
-    info.pViewports = &viewport;
+    info.pViewports = nullptr;
     info.scissorCount = 1;
-    info.pScissors = &scissor;
+    info.pScissors = nullptr;
     return info;
   }();
 
@@ -517,8 +1179,19 @@ void Application::createGraphicsPipeline() {
         return state;
       }();
 
+  VkPipelineDepthStencilStateCreateInfo depthStencilState = []() {
+    VkPipelineDepthStencilStateCreateInfo state{};
+    state.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    state.depthTestEnable = VK_TRUE;
+    state.depthWriteEnable = VK_TRUE;
+    state.depthCompareOp = VK_COMPARE_OP_LESS;
+    state.depthBoundsTestEnable = VK_FALSE;
+    state.stencilTestEnable = VK_FALSE;
+    return state;
+  }();
+
   std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT,
-                                               VK_DYNAMIC_STATE_LINE_WIDTH};
+                                               VK_DYNAMIC_STATE_SCISSOR};
 
   VkPipelineDynamicStateCreateInfo dynamicState = [&dynamicStates]() {
     VkPipelineDynamicStateCreateInfo info{};
@@ -528,38 +1201,32 @@ void Application::createGraphicsPipeline() {
     return info;
   }();
 
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo = []() {
-    VkPipelineLayoutCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    info.setLayoutCount = 0;
-    info.pSetLayouts = nullptr;
-    info.pushConstantRangeCount = 0;
-    info.pPushConstantRanges = nullptr;
+  // Stands in for the render pass with dynamic rendering
+  VkPipelineRenderingCreateInfoKHR renderingInfo = [this]() {
+    VkPipelineRenderingCreateInfoKHR info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    info.colorAttachmentCount = 1;
+    info.pColorAttachmentFormats = &m_swapchainImageFormat;
+    info.depthAttachmentFormat = m_depthFormat;
+    info.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
     return info;
   }();
 
-  VkPipelineLayout pipelineLayout;
-  if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr,
-                             &pipelineLayout) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create pipeline layout");
-  }
-  m_pipelineLayout = pipelineLayout;
-
   VkGraphicsPipelineCreateInfo pipelineInfo =
-      [&shaderStages, &vertInputInfo, &inputAssemblyInfo, &viewportStateInfo,
-       &rasterizerInfo, &multisampling, &colorBlendState, this]() {
+      [&vertInputInfo, &inputAssemblyInfo, &viewportStateInfo,
+       &multisampling, &depthStencilState, &colorBlendState, &dynamicState,
+       &renderingInfo, this]() {
         VkGraphicsPipelineCreateInfo info{};
         info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        info.pNext = m_dynamicRendering ? &renderingInfo : nullptr;
         info.stageCount = 2;
-        info.pStages = shaderStages;
         info.pVertexInputState = &vertInputInfo;
         info.pInputAssemblyState = &inputAssemblyInfo;
         info.pViewportState = &viewportStateInfo;
-        info.pRasterizationState = &rasterizerInfo;
         info.pMultisampleState = &multisampling;
-        info.pDepthStencilState = nullptr;
+        info.pDepthStencilState = &depthStencilState;
         info.pColorBlendState = &colorBlendState;
-        info.pDynamicState = nullptr;
+        info.pDynamicState = &dynamicState;
         info.layout = m_pipelineLayout;
         info.renderPass = m_renderPass;
         info.subpass = 0;
@@ -568,41 +1235,158 @@ void Application::createGraphicsPipeline() {
         return info;
       }();
 
-  VkPipeline graphicsPipeline;
-  if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo,
-                                nullptr, &graphicsPipeline) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create graphics pipeline");
+  // What differs between keys, sized up front so pointers into it stay valid
+  size_t const count = keys.size();
+  std::vector<std::vector<VkSpecializationMapEntry>> mapEntries(count);
+  std::vector<VkSpecializationInfo> specializations(count);
+  std::vector<std::array<VkPipelineShaderStageCreateInfo, 2>> stages(count);
+  std::vector<VkPipelineRasterizationStateCreateInfo> rasterizers(
+      count, rasterizerInfo);
+  std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(count, pipelineInfo);
+
+  for (size_t i = 0; i < count; i++) {
+    PipelineVariants::Key const &key = keys[i];
+
+    for (uint32_t id = 0; id < key.constants.size(); id++) {
+      mapEntries[i].push_back(
+          {id, static_cast<uint32_t>(id * sizeof(uint32_t)), sizeof(uint32_t)});
+    }
+    specializations[i].mapEntryCount =
+        static_cast<uint32_t>(mapEntries[i].size());
+    specializations[i].pMapEntries = mapEntries[i].data();
+    specializations[i].dataSize = key.constants.size() * sizeof(uint32_t);
+    specializations[i].pData = key.constants.data();
+
+    // Both stages get every constant; a stage ignores ids it doesn't declare
+    stages[i] = {vertStageInfo, fragStageInfo};
+    for (VkPipelineShaderStageCreateInfo &stage : stages[i]) {
+      stage.pSpecializationInfo =
+          key.constants.empty() ? nullptr : &specializations[i];
+    }
+
+    rasterizers[i].polygonMode = key.polygonMode;
+    rasterizers[i].cullMode = key.cullMode;
+
+    pipelineInfos[i].pStages = stages[i].data();
+    pipelineInfos[i].pRasterizationState = &rasterizers[i];
+  }
+
+  std::vector<VkPipeline> pipelines;
+  try {
+    pipelines = m_objectCache->acquire(pipelineInfos.data(),
+                                       static_cast<uint32_t>(count),
+                                       m_pipelineCache);
+  } catch (...) {
+    m_objectCache->release(fragShaderModule);
+    m_objectCache->release(vertShaderModule);
+    throw;
   }
-  m_graphicsPipeline = graphicsPipeline;
 
-  vkDestroyShaderModule(m_device, fragShaderModule, nullptr);
-  vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
+  // The pipelines hold on to them, so that their keys stay unique
+  m_objectCache->release(fragShaderModule);
+  m_objectCache->release(vertShaderModule);
+  return pipelines;
 }
 
-void Application::createFramebuffers() {
-  for (VkImageView const &imageView : m_swapchainImageViews) {
-    VkImageView attachments[] = {imageView};
+// Vertex and fragment shader sources of the graphics pipelines
+std::array<std::string, 2> Application::graphicsShaders() const {
+  if (!m_indirectScene)
+    return {"Basic.vert", "Basic.frag"};
+  if (m_descriptorHeap)
+    return {"InstancedBindless.vert", "Instanced.frag"};
+  return {"Instanced.vert", "Instanced.frag"};
+}
 
-    VkFramebufferCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    info.renderPass = m_renderPass;
-    info.attachmentCount = 1;
-    info.pAttachments = attachments;
-    info.width = m_swapchainExtent.width;
-    info.height = m_swapchainExtent.height;
-    info.layers = 1;
+void Application::createShaderWatcher() {
+  if (m_settings.shaderSourceDirectory.empty())
+    return;
 
-    VkFramebuffer framebuffer;
-    if (vkCreateFramebuffer(m_device, &info, nullptr, &framebuffer) !=
-        VK_SUCCESS) {
-      throw std::runtime_error("Failed to create framebuffer");
+  std::array<std::string, 2> const shaders = graphicsShaders();
+  m_shaderWatcher = std::make_unique<ShaderWatcher>(
+      m_settings.shaderSourceDirectory, m_settings.shaderDirectory,
+      [this, shaders](std::string const &name) {
+        if (name == shaders[0] || name == shaders[1])
+          m_graphicsShadersChanged = true;
+        else
+          std::cout << "Only the graphics pipeline is reloaded, ignoring "
+                    << name << std::endl;
+      });
+  m_settings.shaderDirectory = m_shaderWatcher->outputDirectory();
+}
+
+// Swaps in a pipeline rebuilt since the last frame, starts a rebuild when
+// shaders changed, and re-records command buffers once a specialized variant
+// is ready. Never waits on a build, which may take a while.
+void Application::updateGraphicsPipeline() {
+  if (m_pipelineRebuild.valid() &&
+      m_pipelineRebuild.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    try {
+      pipeline = m_pipelineRebuild.get();
+    } catch (std::exception const &e) {
+      std::cerr << "Keeping the previous graphics pipeline: " << e.what()
+                << std::endl;
+    }
+
+    if (pipeline != VK_NULL_HANDLE) {
+      // Variants are compiled again from the new shaders, drawing with the
+      // new generic pipeline meanwhile
+      VkPipeline const oldPipeline = m_graphicsPipeline;
+      std::shared_ptr<PipelineVariants> oldVariants =
+          std::move(m_pipelineVariants);
+      m_graphicsPipeline = pipeline;
+      requestPipelineVariants();
+
+      // The old variants go along with this function
+      deferDestruction([this, oldPipeline, oldVariants]() {
+        m_objectCache->release(oldPipeline);
+      });
+      markCommandBuffersDirty();
+      std::cout << "Reloaded graphics pipeline" << std::endl;
     }
-    m_swapchainFramebuffers.push_back(framebuffer);
   }
+
+  if (!m_pipelineRebuild.valid() && m_graphicsShadersChanged.exchange(false)) {
+    m_pipelineRebuild = m_pipelineThreads->submit([this]() {
+      return buildGraphicsPipelines({PipelineVariants::Key{}})[0];
+    });
+  }
+
+  if (m_pipelineVariants->takeFinished()) {
+    markCommandBuffersDirty();
+  }
+}
+
+// With dynamic rendering the image views are named while recording instead
+void Application::createFramebuffers() {
+  if (!m_dynamicRendering) {
+    for (VkImageView const &imageView : m_swapchainImageViews) {
+      VkImageView attachments[] = {imageView, m_depthImageView};
+
+      VkFramebufferCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+      info.renderPass = m_renderPass;
+      info.attachmentCount = 2;
+      info.pAttachments = attachments;
+      info.width = m_swapchainExtent.width;
+      info.height = m_swapchainExtent.height;
+      info.layers = 1;
+
+      VkFramebuffer framebuffer;
+      if (vkCreateFramebuffer(m_device, &info, nullptr, &framebuffer) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("Failed to create framebuffer");
+      }
+      m_swapchainFramebuffers.push_back(framebuffer);
+    }
+  }
+
+  markCommandBuffersDirty();
 }
 
 void Application::createCommandPool() {
-  QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice, m_surface);
+  QueueFamilyIndices const &indices = m_queueFamilies;
 
   VkCommandPoolCreateInfo info{};
   info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -617,22 +1401,237 @@ void Application::createCommandPool() {
   m_commandPool = commandPool;
 }
 
-void Application::createCommandBuffer() {
+void Application::createCommandBuffers() {
+  std::vector<VkCommandBuffer> commandBuffers(m_settings.framesInFlight);
+
   VkCommandBufferAllocateInfo info{};
   info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   info.commandPool = m_commandPool;
   info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  info.commandBufferCount = 1;
+  info.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+  if (vkAllocateCommandBuffers(m_device, &info, commandBuffers.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate command buffers");
+  }
+  m_commandBuffers = commandBuffers;
+}
+
+void Application::createImageCommandBuffers() {
+  if (m_settings.recordMode != RecordMode::Prerecorded)
+    return;
+
+  std::vector<VkCommandBuffer> commandBuffers(m_swapchainImages.size());
+
+  VkCommandBufferAllocateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  info.commandPool = m_commandPool;
+  info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  info.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+  if (vkAllocateCommandBuffers(m_device, &info, commandBuffers.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate command buffers");
+  }
+  m_imageCommandBuffers = commandBuffers;
+  m_imageCommandBuffersDirty.assign(commandBuffers.size(), true);
+}
+
+void Application::createWorkerCommandBuffers() {
+  if (m_settings.recordMode != RecordMode::Parallel)
+    return;
+
+  m_recordingThreads = std::make_unique<ThreadPool>(m_settings.recordThreads);
+  size_t const workerCount = m_recordingThreads->size();
+
+  QueueFamilyIndices const &indices = m_queueFamilies;
+
+  m_workerCommandPools.resize(m_settings.framesInFlight);
+  m_workerCommandBuffers.resize(m_settings.framesInFlight);
+
+  for (uint32_t frame = 0; frame < m_settings.framesInFlight; frame++) {
+    for (size_t worker = 0; worker < workerCount; worker++) {
+      // Pools are reset wholesale every frame instead of per buffer
+      VkCommandPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+      poolInfo.queueFamilyIndex = indices.graphicsFamily.value();
+
+      VkCommandPool commandPool;
+      if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &commandPool) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("Failed to create command pool");
+      }
+      m_workerCommandPools[frame].push_back(commandPool);
+
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.commandPool = commandPool;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      allocInfo.commandBufferCount = 1;
+
+      VkCommandBuffer commandBuffer;
+      if (vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate command buffer");
+      }
+      m_workerCommandBuffers[frame].push_back(commandBuffer);
+    }
+  }
+}
+
+void Application::createScene() {
+  // The indirect scene is a handful of commands whatever its size, so it is
+  // never worth spreading across threads
+  if (m_settings.drawPath == DrawPath::Indirect &&
+      m_settings.recordMode == RecordMode::Parallel) {
+    throw std::runtime_error(
+        "Parallel recording only supports the direct draw path");
+  }
+
+  if (m_settings.drawPath == DrawPath::Indirect) {
+    // Async culling writes an output per frame in flight, so it can run
+    // while earlier frames still draw theirs
+    uint32_t const outputCount =
+        m_computeScheduler ? m_settings.framesInFlight : 1;
+    m_indirectScene = std::make_unique<IndirectScene>(
+        m_device, *m_allocator, *m_objectCache, *m_uploadManager,
+        m_descriptorHeap.get(), m_settings.instanceCount,
+        m_enabledFeatures.multiDrawIndirect == VK_TRUE,
+        m_cmdDrawIndexedIndirectCount, m_computeSharingFamilies, outputCount);
+    m_sceneOutputPoints.assign(outputCount, 0);
+  } else {
+    m_drawCommands.assign(m_settings.drawCount, DrawCommand{3, 1, 0, 0});
+  }
+  m_view = {{0.0f, 0.0f}, m_settings.zoom};
+  markCommandBuffersDirty();
+}
+
+void Application::createCullingPass() {
+  if (!m_indirectScene || m_settings.cullMode == CullMode::Off)
+    return;
+
+  m_cullingPass = std::make_unique<CullingPass>(
+      m_device, *m_allocator, *m_objectCache, m_pipelineCache,
+      *m_indirectScene,
+      m_settings.cullMode == CullMode::Occlusion,
+      m_computeScheduler != nullptr, m_settings.shaderDirectory);
+  m_cullingPass->resize(m_depthImage, m_depthFormat, m_swapchainExtent,
+                        [this](std::function<void()> destroy) {
+                          deferDestruction(std::move(destroy));
+                        });
+  markCommandBuffersDirty();
+}
+
+// The frame as a render graph: culling, unless it runs on async compute,
+// then the main pass. The graph places every layout transition and barrier
+// between them and against the neighbouring frames.
+void Application::createRenderGraph() {
+  m_renderGraph = std::make_unique<RenderGraph>(m_device, *m_allocator);
+
+  // Rendered from scratch every frame, after the acquire semaphore's wait
+  RenderGraph::ResourceId const color = m_renderGraph->importImage(
+      "swapchain", m_swapchainImages, m_swapchainImageViews,
+      m_swapchainImageFormat,
+      {VK_IMAGE_LAYOUT_UNDEFINED,
+       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0},
+      {m_settings.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                           : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0});
+  // Kept between frames, read-only for the next frame's culling pass
+  RenderGraph::ImageState const depthBetweenFrames = {
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT};
+  RenderGraph::ResourceId const depth = m_renderGraph->importImage(
+      "depth", {m_depthImage}, {m_depthImageView}, m_depthFormat,
+      depthBetweenFrames, depthBetweenFrames);
+
+  // On async compute culling is submitted separately by drawFrame
+  if (m_cullingPass && !m_computeScheduler) {
+    bool const occlusion = m_settings.cullMode == CullMode::Occlusion;
+    m_renderGraph->addPass(
+        "cull",
+        [depth, occlusion](RenderGraph::PassBuilder &pass) {
+          if (occlusion)
+            pass.read(depth, RenderGraph::Usage::ComputeSampled);
+          // Its output is the scene's draw commands, which it synchronizes
+          // itself
+          pass.sideEffects();
+        },
+        [this](VkCommandBuffer commandBuffer, uint32_t index) {
+          m_cullingPass->record(commandBuffer, m_view, sceneOutput(index));
+        });
+  }
+
+  m_renderGraph->addPass(
+      "main",
+      [color, depth](RenderGraph::PassBuilder &pass) {
+        pass.write(color, RenderGraph::Usage::ColorAttachment);
+        pass.write(depth, RenderGraph::Usage::DepthAttachment);
+      },
+      [this](VkCommandBuffer commandBuffer, uint32_t index) {
+        recordMainPass(commandBuffer, index);
+      });
+
+  m_renderGraph->compile();
+  if (m_settings.printRenderGraph)
+    m_renderGraph->writeSchedule(std::cout);
+}
+
+// Submits on the graphics queue without waiting; later submissions on that
+// queue are ordered after it, and the command buffer is freed once the
+// graphics timeline has moved past it
+void Application::submitOneTimeCommands(
+    std::function<void(VkCommandBuffer)> const &record) {
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = m_commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
 
   VkCommandBuffer commandBuffer;
-  if (vkAllocateCommandBuffers(m_device, &info, &commandBuffer) != VK_SUCCESS) {
+  if (vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer) !=
+      VK_SUCCESS) {
     throw std::runtime_error("Failed to allocate command buffer");
   }
-  m_commandBuffer = commandBuffer;
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin recording command buffer");
+  }
+  record(commandBuffer);
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record command buffer");
+  }
+
+  Timeline::Submission submission;
+  submission.commandBuffers = {commandBuffer};
+  m_graphicsTimeline->submit(submission);
+
+  deferDestruction([this, commandBuffer]() {
+    vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+  });
+}
+
+// Call whenever the scene, a pipeline or a framebuffer changes so prerecorded
+// command buffers pick up the change the next time their image is drawn
+void Application::markCommandBuffersDirty() {
+  m_imageCommandBuffersDirty.assign(m_imageCommandBuffers.size(), true);
+}
+
+// Scene output drawn by the frame rendering to swapchain image `index`.
+// Prerecorded command buffers are tied to their image, so they keep to one.
+uint32_t Application::sceneOutput(uint32_t index) const {
+  uint32_t const slot =
+      m_settings.recordMode == RecordMode::Prerecorded ? index : m_currentFrame;
+  return slot % m_indirectScene->outputCount();
 }
 
 void Application::recordCommandBuffer(VkCommandBuffer commandBuffer,
-                                      uint32_t index) {
+                                      uint32_t index, uint32_t profilerSlot) {
   VkCommandBufferBeginInfo commandBufferBeginInfo = []() {
     VkCommandBufferBeginInfo info{};
     info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -646,90 +1645,426 @@ void Application::recordCommandBuffer(VkCommandBuffer commandBuffer,
     throw std::runtime_error("Failed to begin recording command buffer");
   }
 
-  VkClearValue clearValue = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-  VkRenderPassBeginInfo renderPassBeginInfo = [this, &index, &clearValue]() {
-    VkRenderPassBeginInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    info.renderPass = m_renderPass;
-    info.framebuffer = m_swapchainFramebuffers[index];
-    info.renderArea.offset = {0, 0};
-    info.renderArea.extent = m_swapchainExtent;
-    info.clearValueCount = 1;
-    info.pClearValues = &clearValue;
-    return info;
-  }();
+  // The graphics pipelines all share m_pipelineLayout, so the heap stays
+  // bound for the whole frame; draws bind no descriptors of their own
+  if (m_descriptorHeap) {
+    m_descriptorHeap->bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           m_pipelineLayout);
+  }
+
+  RenderGraph::PassHook beginPass;
+  RenderGraph::PassHook endPass;
+  if (m_profiler) {
+    m_profiler->beginFrame(commandBuffer, profilerSlot);
+    beginPass = [this, profilerSlot](VkCommandBuffer commandBuffer,
+                                     std::string const &name) {
+      m_profiler->beginPass(commandBuffer, profilerSlot, name);
+    };
+    endPass = [this, profilerSlot](VkCommandBuffer commandBuffer,
+                                   std::string const &) {
+      m_profiler->endPass(commandBuffer, profilerSlot);
+    };
+  }
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
-                       VK_SUBPASS_CONTENTS_INLINE);
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    m_graphicsPipeline);
-  vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-  vkCmdEndRenderPass(commandBuffer);
+  m_renderGraph->execute(commandBuffer, index, beginPass, endPass);
 
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
     throw std::runtime_error("Failed to record command buffer");
   }
 }
 
+void Application::recordMainPass(VkCommandBuffer commandBuffer,
+                                 uint32_t index) {
+  if (m_settings.recordMode == RecordMode::Parallel) {
+    std::vector<VkCommandBuffer> secondaryCommandBuffers =
+        recordSecondaryCommandBuffers(index);
+
+    beginRendering(commandBuffer, index, true);
+    if (!secondaryCommandBuffers.empty()) {
+      vkCmdExecuteCommands(
+          commandBuffer,
+          static_cast<uint32_t>(secondaryCommandBuffers.size()),
+          secondaryCommandBuffers.data());
+    }
+    endRendering(commandBuffer);
+  } else {
+    beginRendering(commandBuffer, index, false);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      m_pipelineVariant.pipeline());
+    recordViewportAndScissor(commandBuffer);
+    if (m_indirectScene) {
+      m_indirectScene->record(commandBuffer, m_pipelineLayout, m_view,
+                              sceneOutput(index));
+    } else {
+      recordDraws(commandBuffer, 0, m_drawCommands.size());
+    }
+    endRendering(commandBuffer);
+  }
+}
+
+// Each worker records its share of the draws into its own secondary command
+// buffer, allocated from a pool owned by that worker and frame in flight
+std::vector<VkCommandBuffer>
+Application::recordSecondaryCommandBuffers(uint32_t index) {
+  size_t const workerCount = m_recordingThreads->size();
+  size_t const drawsPerWorker =
+      (m_drawCommands.size() + workerCount - 1) / workerCount;
+
+  std::vector<VkCommandBuffer> commandBuffers;
+  std::vector<std::future<void>> tasks;
+
+  for (size_t worker = 0; worker < workerCount; worker++) {
+    size_t const begin = worker * drawsPerWorker;
+    size_t const end = std::min(begin + drawsPerWorker, m_drawCommands.size());
+    if (begin >= end)
+      break;
+
+    VkCommandPool commandPool = m_workerCommandPools[m_currentFrame][worker];
+    VkCommandBuffer commandBuffer =
+        m_workerCommandBuffers[m_currentFrame][worker];
+    commandBuffers.push_back(commandBuffer);
+
+    tasks.push_back(m_recordingThreads->submit([this, commandPool,
+                                                commandBuffer, index, begin,
+                                                end]() {
+      vkResetCommandPool(m_device, commandPool, 0);
+
+      VkCommandBufferInheritanceRenderingInfoKHR renderingInfo{};
+      renderingInfo.sType =
+          VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+      renderingInfo.colorAttachmentCount = 1;
+      renderingInfo.pColorAttachmentFormats = &m_swapchainImageFormat;
+      renderingInfo.depthAttachmentFormat = m_depthFormat;
+      renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+      renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+      VkCommandBufferInheritanceInfo inheritanceInfo{};
+      inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+      inheritanceInfo.pNext = m_dynamicRendering ? &renderingInfo : nullptr;
+      inheritanceInfo.renderPass = m_renderPass;
+      inheritanceInfo.subpass = 0;
+      inheritanceInfo.framebuffer = m_dynamicRendering
+                                        ? VK_NULL_HANDLE
+                                        : m_swapchainFramebuffers[index];
+      inheritanceInfo.pipelineStatistics =
+          m_profiler ? m_profiler->pipelineStatisticFlags() : 0;
+
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                        VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+      beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+      if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error(
+            "Failed to begin recording secondary command buffer");
+      }
+
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        m_pipelineVariant.pipeline());
+      recordViewportAndScissor(commandBuffer);
+      recordDraws(commandBuffer, begin, end);
+
+      if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record secondary command buffer");
+      }
+    }));
+  }
+
+  // Let every worker finish before rethrowing, they share the frame's pools
+  for (std::future<void> &task : tasks) {
+    task.wait();
+  }
+  for (std::future<void> &task : tasks) {
+    task.get();
+  }
+
+  return commandBuffers;
+}
+
+// Starts the main pass on swapchain image `index`. The render graph has
+// already moved the attachments into the layouts used here.
+void Application::beginRendering(VkCommandBuffer commandBuffer,
+                                 uint32_t index,
+                                 bool secondaryCommandBuffers) {
+  VkClearValue clearValues[2] = {};
+  clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  clearValues[1].depthStencil = {1.0f, 0};
+
+  if (!m_dynamicRendering) {
+    VkRenderPassBeginInfo renderPassBeginInfo = [this, &index,
+                                                 &clearValues]() {
+      VkRenderPassBeginInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+      info.renderPass = m_renderPass;
+      info.framebuffer = m_swapchainFramebuffers[index];
+      info.renderArea.offset = {0, 0};
+      info.renderArea.extent = m_swapchainExtent;
+      info.clearValueCount = 2;
+      info.pClearValues = clearValues;
+      return info;
+    }();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+                         secondaryCommandBuffers
+                             ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                             : VK_SUBPASS_CONTENTS_INLINE);
+    return;
+  }
+
+  VkRenderingAttachmentInfoKHR colorAttachment{};
+  colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  colorAttachment.imageView = m_swapchainImageViews[index];
+  colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.clearValue = clearValues[0];
+
+  VkRenderingAttachmentInfoKHR depthAttachment{};
+  depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  depthAttachment.imageView = m_depthImageView;
+  depthAttachment.imageLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.clearValue = clearValues[1];
+
+  VkRenderingInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  renderingInfo.flags =
+      secondaryCommandBuffers
+          ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR
+          : 0;
+  renderingInfo.renderArea.offset = {0, 0};
+  renderingInfo.renderArea.extent = m_swapchainExtent;
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachments = &colorAttachment;
+  renderingInfo.pDepthAttachment = &depthAttachment;
+
+  m_cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void Application::endRendering(VkCommandBuffer commandBuffer) {
+  if (m_dynamicRendering)
+    m_cmdEndRendering(commandBuffer);
+  else
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void Application::recordDraws(VkCommandBuffer commandBuffer, size_t begin,
+                              size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    DrawCommand const &draw = m_drawCommands[i];
+    vkCmdDraw(commandBuffer, draw.vertexCount, draw.instanceCount,
+              draw.firstVertex, draw.firstInstance);
+  }
+}
+
+void Application::recordViewportAndScissor(VkCommandBuffer commandBuffer) {
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(m_swapchainExtent.width);
+  viewport.height = static_cast<float>(m_swapchainExtent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = m_swapchainExtent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
 void Application::createSyncObjects() {
   VkSemaphoreCreateInfo semaphoreInfo{};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  VkFenceCreateInfo fenceInfo{};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+  m_imageAvailableSemaphores.resize(m_settings.framesInFlight);
+  m_renderFinishedSemaphores.resize(m_settings.framesInFlight);
+  m_framePoints.resize(m_settings.framesInFlight, 0);
+  m_imagePoints.resize(m_swapchainImages.size(), 0);
 
-  if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr,
-                        &m_imageAvailableSemaphore) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create semaphore");
-  }
-  if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr,
-                        &m_renderFinishedSemaphore) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create semaphore");
-  }
-  if (vkCreateFence(m_device, &fenceInfo, nullptr, &m_inFlightFence) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("Failed to create fence");
+  for (uint32_t i = 0; i < m_settings.framesInFlight; i++) {
+    if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr,
+                          &m_imageAvailableSemaphores[i]) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create semaphore");
+    }
+    if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr,
+                          &m_renderFinishedSemaphores[i]) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create semaphore");
+    }
   }
 }
 
+void Application::createProfiler() {
+  if (!m_settings.profile)
+    return;
+
+  QueueFamilyIndices const &indices = m_queueFamilies;
+
+  // Prerecorded command buffers carry their queries with them, so those need
+  // one set per image rather than per frame in flight
+  uint32_t const slotCount =
+      m_settings.recordMode == RecordMode::Prerecorded
+          ? static_cast<uint32_t>(m_imageCommandBuffers.size())
+          : m_settings.framesInFlight;
+
+  m_profiler = std::make_unique<GpuProfiler>(
+      m_physicalDevice, m_device, indices.graphicsFamily.value(), slotCount,
+      m_enabledFeatures.pipelineStatisticsQuery == VK_TRUE);
+}
+
+void Application::reportProfile() {
+  if (!m_profiler)
+    return;
+
+  // The device is idle, so every outstanding frame can be read back
+  m_profiler->collectAll();
+
+  m_profiler->writeSummary(std::cout);
+  m_allocator->writeStatistics(std::cout);
+  m_objectCache->writeStatistics(std::cout);
+  m_startupProfile.writeSummary(std::cout);
+  m_framePacer.writeSummary(std::cout);
+
+  auto const writeReport = [](std::string const &path, auto const &report) {
+    if (path.empty())
+      return;
+
+    std::ofstream file(path);
+    if (!file) {
+      std::cerr << "Failed to open " << path << std::endl;
+      return;
+    }
+
+    bool const json =
+        path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (json)
+      report.writeJson(file);
+    else
+      report.writeCsv(file);
+  };
+  writeReport(m_settings.profileOutput, *m_profiler);
+  writeReport(m_settings.startupProfileOutput, m_startupProfile);
+}
+
 void Application::drawFrame() {
-  vkWaitForFences(m_device, 1, &m_inFlightFence, VK_TRUE, UINT64_MAX);
-  vkResetFences(m_device, 1, &m_inFlightFence);
+  m_graphicsTimeline->wait(m_framePoints[m_currentFrame]);
+  destroyRetiredObjects();
+  updateGraphicsPipeline();
 
   uint32_t imageIndex;
-  vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX,
-                        m_imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-  vkResetCommandBuffer(m_commandBuffer, 0);
-  recordCommandBuffer(m_commandBuffer, imageIndex);
-
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-  VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphore};
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &m_commandBuffer;
-  VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphore};
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
-
-  if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlightFence) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("Failed to draw command buffer");
+  if (m_settings.headless) {
+    imageIndex = m_currentFrame;
+  } else {
+    VkResult result = vkAcquireNextImageKHR(
+        m_device, m_swapchain, UINT64_MAX,
+        m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE,
+        &imageIndex);
+    // Nothing was submitted for this frame yet, so its point stays reached
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      recreateSwapchain();
+      return;
+    }
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      throw std::runtime_error("Failed to acquire swapchain image");
+    }
+  }
+
+  // With more frames in flight than swapchain images an older frame may still
+  // be rendering to the image we just acquired
+  m_graphicsTimeline->wait(m_imagePoints[imageIndex]);
+
+  bool const prerecorded = m_settings.recordMode == RecordMode::Prerecorded;
+  uint32_t const profilerSlot = prerecorded ? imageIndex : m_currentFrame;
+
+  // Whatever last used this slot has completed, so its queries are ready
+  if (m_profiler) {
+    m_profiler->collect(profilerSlot);
+  }
+
+  auto const recordingStart = std::chrono::steady_clock::now();
+
+  uint32_t const output = m_indirectScene ? sceneOutput(imageIndex) : 0;
+  uint64_t computePoint = 0;
+  if (m_computeScheduler) {
+    m_computeScheduler->addJob(
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        [this, output](VkCommandBuffer commandBuffer) {
+          m_cullingPass->record(commandBuffer, m_view, output);
+        });
+    // Culling only has to wait for the draws that last read its output,
+    // unless it samples the depth the previous frame rendered
+    uint64_t const graphicsPoint =
+        m_settings.cullMode == CullMode::Occlusion
+            ? m_graphicsTimeline->lastSubmitted()
+            : m_sceneOutputPoints[output];
+    computePoint = m_computeScheduler->submit(m_currentFrame, graphicsPoint);
+  }
+
+  VkCommandBuffer commandBuffer;
+  if (prerecorded) {
+    commandBuffer = m_imageCommandBuffers[imageIndex];
+    if (m_imageCommandBuffersDirty[imageIndex]) {
+      vkResetCommandBuffer(commandBuffer, 0);
+      recordCommandBuffer(commandBuffer, imageIndex, profilerSlot);
+      m_imageCommandBuffersDirty[imageIndex] = false;
+    }
+  } else {
+    commandBuffer = m_commandBuffers[m_currentFrame];
+    vkResetCommandBuffer(commandBuffer, 0);
+    recordCommandBuffer(commandBuffer, imageIndex, profilerSlot);
+  }
+
+  m_recordingTime += std::chrono::steady_clock::now() - recordingStart;
+
+  // Uploads that finished since the last frame are handed over to the
+  // graphics queue ahead of this frame's submission
+  m_uploadManager->update();
+
+  Timeline::Submission submission;
+  submission.commandBuffers = {commandBuffer};
+  if (!m_settings.headless) {
+    submission.waitSemaphores.push_back(
+        m_imageAvailableSemaphores[m_currentFrame]);
+    submission.waitStages.push_back(
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    submission.signalSemaphores.push_back(
+        m_renderFinishedSemaphores[m_currentFrame]);
+  }
+  // Only the draws consume what async compute produced
+  if (computePoint != 0) {
+    submission.waits.push_back({m_computeTimeline.get(), computePoint,
+                                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT});
+  }
+
+  uint64_t const point = m_graphicsTimeline->submit(submission);
+  m_framePoints[m_currentFrame] = point;
+  m_imagePoints[imageIndex] = point;
+  if (m_indirectScene)
+    m_sceneOutputPoints[output] = point;
+
+  if (m_profiler) {
+    m_profiler->markSubmitted(profilerSlot);
+  }
+  m_startupProfile.markFirstFrame();
+
+  if (m_settings.headless) {
+    // Nothing is presented, so the frame ends with its submission
+    m_framePacer.endFrame();
+    m_currentFrame = (m_currentFrame + 1) % m_settings.framesInFlight;
+    return;
   }
 
   VkSwapchainKHR swapchains[] = {m_swapchain};
-  VkPresentInfoKHR presentInfo = [&signalSemaphores, &swapchains,
-                                  &imageIndex]() {
+  VkPresentInfoKHR presentInfo = [this, &swapchains, &imageIndex]() {
     VkPresentInfoKHR info{};
     info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     info.waitSemaphoreCount = 1;
-    info.pWaitSemaphores = signalSemaphores;
+    info.pWaitSemaphores = &m_renderFinishedSemaphores[m_currentFrame];
     info.swapchainCount = 1;
     info.pSwapchains = swapchains;
     info.pImageIndices = &imageIndex;
@@ -737,26 +2072,91 @@ void Application::drawFrame() {
     return info;
   }();
 
-  vkQueuePresentKHR(m_presentQueue, &presentInfo);
+  VkResult result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+  m_framePacer.endFrame();
+
+  m_currentFrame = (m_currentFrame + 1) % m_settings.framesInFlight;
+
+  bool const resized = m_window->takeFramebufferResized();
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+      resized) {
+    recreateSwapchain();
+  } else if (result != VK_SUCCESS) {
+    throw std::runtime_error("Failed to present swapchain image");
+  }
 }
 
 void Application::cleanup() {
-  vkDestroySemaphore(m_device, m_imageAvailableSemaphore, nullptr);
-  vkDestroySemaphore(m_device, m_renderFinishedSemaphore, nullptr);
-  vkDestroyFence(m_device, m_inFlightFence, nullptr);
+  m_shaderWatcher.reset();
+  m_pipelineVariants.reset();
+  m_pipelineThreads.reset();
+  // Builds still pending when init or a reload was cut short
+  for (std::future<VkPipeline> *build :
+       {&m_graphicsPipelineBuild, &m_pipelineRebuild}) {
+    if (build->valid()) {
+      try {
+        m_objectCache->release(build->get());
+      } catch (std::exception const &) {
+      }
+    }
+  }
+  destroyRetiredObjects(true);
+
+  for (VkSemaphore semaphore : m_imageAvailableSemaphores) {
+    vkDestroySemaphore(m_device, semaphore, nullptr);
+  }
+  for (VkSemaphore semaphore : m_renderFinishedSemaphores) {
+    vkDestroySemaphore(m_device, semaphore, nullptr);
+  }
+  m_profiler.reset();
+  m_recordingThreads.reset();
+  m_computeScheduler.reset();
+  m_renderGraph.reset();
+  m_cullingPass.reset();
+  m_indirectScene.reset();
+  m_descriptorHeap.reset();
+  m_uploadManager.reset();
+  m_computeTimeline.reset();
+  m_transferTimeline.reset();
+  m_graphicsTimeline.reset();
+  for (auto const &commandPools : m_workerCommandPools) {
+    for (VkCommandPool commandPool : commandPools) {
+      vkDestroyCommandPool(m_device, commandPool, nullptr);
+    }
+  }
   vkDestroyCommandPool(m_device, m_commandPool, nullptr);
 
   for (auto framebuffer : m_swapchainFramebuffers) {
     vkDestroyFramebuffer(m_device, framebuffer, nullptr);
   }
 
-  vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
-  vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
-  vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+  m_objectCache->release(m_graphicsPipeline);
+  savePipelineCache();
+  vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+  m_objectCache->release(m_pipelineLayout);
+  m_objectCache->release(m_renderPass);
 
   for (VkImageView imageView : m_swapchainImageViews) {
     vkDestroyImageView(m_device, imageView, nullptr);
   }
+  vkDestroyImageView(m_device, m_depthImageView, nullptr);
+  vkDestroyImage(m_device, m_depthImage, nullptr);
+  if (m_depthImage != VK_NULL_HANDLE) {
+    m_allocator->free(m_depthImageAllocation);
+  }
+
+  vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
+  if (m_settings.headless) {
+    for (VkImage image : m_swapchainImages) {
+      vkDestroyImage(m_device, image, nullptr);
+    }
+  }
+  for (MemoryAllocator::Allocation const &allocation :
+       m_offscreenImageAllocations) {
+    m_allocator->free(allocation);
+  }
+  m_allocator.reset();
+  m_objectCache.reset();
 
   vkDestroyDevice(m_device, nullptr);
   if (m_enableValidationLayers) {
@@ -764,6 +2164,7 @@ void Application::cleanup() {
   }
   vkDestroySurfaceKHR(m_vulkanInstance, m_surface, nullptr);
   vkDestroyInstance(m_vulkanInstance, nullptr);
+  m_validationSink.reset();
 }
 
 bool Application::checkValidationLayerSupport() const {
@@ -792,12 +2193,14 @@ bool Application::checkValidationLayerSupport() const {
 }
 
 std::vector<const char *> Application::getRequiredExtensions() {
-  uint32_t extensionsCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&extensionsCount);
+  std::vector<const char *> extensions;
 
-  std::vector<const char *> extensions(glfwExtensions,
-                                       glfwExtensions + extensionsCount);
+  if (!m_settings.headless) {
+    uint32_t extensionsCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&extensionsCount);
+    extensions.assign(glfwExtensions, glfwExtensions + extensionsCount);
+  }
 
   if (m_enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -806,100 +2209,103 @@ std::vector<const char *> Application::getRequiredExtensions() {
   return extensions;
 }
 
-std::optional<VkPhysicalDevice> Application::mostSuitableDevice(
-    std::vector<VkPhysicalDevice> const &physicalDevices, VkSurfaceKHR surface,
+bool Application::isDeviceSuitable(
+    DeviceCapabilities const &device,
     std::vector<char const *> const &requiredExtensions) {
-  auto const score = [&surface, &requiredExtensions](
-                         VkPhysicalDevice device) -> std::optional<int> {
-    VkPhysicalDeviceProperties properties;
-    VkPhysicalDeviceFeatures features;
-    vkGetPhysicalDeviceProperties(device, &properties);
-    vkGetPhysicalDeviceFeatures(device, &features);
-
-    QueueFamilyIndices indices = findQueueFamilies(device, surface);
-
-    bool extensionsSupported =
-        checkDeviceExtensionSupport(device, requiredExtensions);
-    bool swapchainAdequate = extensionsSupported ? [&device, &surface](){
-      SwapchainSupportDetails details = querySwapchainSupport(device, surface);
-      return !details.formats.empty() && !details.presentModes.empty();
-    }() : false;
-
-    if (!indices.isComplete() || !extensionsSupported || !swapchainAdequate)
-      return std::nullopt;
-
-    int score =
-        properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? 1 : 0;
-    return score;
-  };
-
-  std::set<std::pair<VkPhysicalDevice, int>,
-           std::function<bool(std::pair<VkPhysicalDevice, int> const &,
-                              std::pair<VkPhysicalDevice, int> const &)>>
-      deviceList(
-          [](auto const &a, auto const &b) { return a.second < b.second; });
+  if (!findQueueFamilies(device).isComplete() ||
+      !device.hasExtensions(requiredExtensions))
+    return false;
+
+  // Headless rendering has no surface to build a swapchain for
+  if (device.presentSupport.empty())
+    return true;
+  return !device.surfaceFormats.empty() && !device.presentModes.empty();
+}
 
-  for (const auto &device : physicalDevices) {
-    std::optional<int> deviceScore = score(device);
-    if (deviceScore) {
-      deviceList.insert(std::pair(device, deviceScore.value()));
+// Ranks by measured copy bandwidth when every suitable device could be
+// benchmarked, then by device type and device-local memory. Benchmarking is
+// skipped when there is nothing to choose between.
+std::optional<size_t> Application::mostSuitableDevice(
+    std::vector<DeviceCapabilities> const &devices,
+    std::vector<char const *> const &requiredExtensions,
+    DeviceBenchmark *benchmark) {
+  std::vector<size_t> suitable;
+  for (size_t i = 0; i < devices.size(); i++) {
+    if (isDeviceSuitable(devices[i], requiredExtensions))
+      suitable.push_back(i);
+  }
+  if (suitable.empty())
+    return std::nullopt;
+
+  std::vector<double> bandwidths(devices.size(), 0.0);
+  if (benchmark && suitable.size() > 1) {
+    for (size_t i : suitable) {
+      std::optional<double> bandwidth =
+          benchmark->copyBandwidth(devices[i]);
+      if (!bandwidth) {
+        bandwidths.assign(devices.size(), 0.0);
+        break;
+      }
+      bandwidths[i] = *bandwidth;
     }
   }
 
-  return deviceList.size() > 0 ? std::make_optional(deviceList.begin()->first)
-                               : std::nullopt;
-}
-
-bool Application::checkDeviceExtensionSupport(
-    VkPhysicalDevice physicalDevice,
-    std::vector<char const *> const &requiredExtensions) {
-  uint32_t extensionCount;
-  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount,
-                                       nullptr);
-
-  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount,
-                                       availableExtensions.data());
-
-  std::unordered_set<std::string> requiredExtensionSet(
-      requiredExtensions.begin(), requiredExtensions.end());
-
-  for (auto const &extension : availableExtensions) {
-    requiredExtensionSet.erase(extension.extensionName);
-  }
+  auto const typeRank = [](VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return 4;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return 3;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return 2;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      return 1;
+    default:
+      return 0;
+    }
+  };
+  auto const score = [&](size_t i) {
+    return std::make_tuple(bandwidths[i],
+                           typeRank(devices[i].properties.deviceType),
+                           devices[i].deviceLocalMemory());
+  };
 
-  return requiredExtensionSet.empty();
+  return *std::max_element(
+      suitable.begin(), suitable.end(),
+      [&score](size_t a, size_t b) { return score(a) < score(b); });
 }
 
-Application::SwapchainSupportDetails
-Application::querySwapchainSupport(VkPhysicalDevice physicalDevice,
-                                   VkSurfaceKHR surface) {
-  SwapchainSupportDetails details;
-
-  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface,
-                                            &details.capabilities);
-
-  uint32_t formatCount;
-  vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount,
-                                       nullptr);
-  if (formatCount != 0) {
-    details.formats.resize(formatCount);
-    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount,
-                                         details.formats.data());
+// `request` is either an index in enumeration order or part of a device name,
+// matched without regard to case
+std::optional<size_t>
+Application::requestedDevice(std::vector<DeviceCapabilities> const &devices,
+                             std::string const &request) {
+  if (request.empty())
+    return std::nullopt;
+
+  if (std::all_of(request.begin(), request.end(),
+                  [](unsigned char c) { return std::isdigit(c); })) {
+    // Indices too long to parse match no GPU either
+    size_t index = 0;
+    char const *end = request.data() + request.size();
+    auto const [parsed, error] = std::from_chars(request.data(), end, index);
+    if (error != std::errc() || parsed != end || index >= devices.size())
+      return std::nullopt;
+    return index;
   }
 
-  uint32_t presentModeCount;
-  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface,
-                                            &presentModeCount, nullptr);
-
-  if (presentModeCount != 0) {
-    details.presentModes.resize(presentModeCount);
-    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface,
-                                              &presentModeCount,
-                                              details.presentModes.data());
+  auto const lower = [](std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return text;
+  };
+  std::string const name = lower(request);
+  for (size_t i = 0; i < devices.size(); i++) {
+    if (lower(devices[i].properties.deviceName).find(name) !=
+        std::string::npos)
+      return i;
   }
-
-  return details;
+  return std::nullopt;
 }
 
 VkSurfaceFormatKHR Application::chooseSwapSurfaceFormat(
@@ -913,10 +2319,27 @@ VkSurfaceFormatKHR Application::chooseSwapSurfaceFormat(
   return formats[0];
 }
 
+VkPresentModeKHR Application::toVkPresentMode(PresentMode mode) {
+  switch (mode) {
+  case PresentMode::Immediate:
+    return VK_PRESENT_MODE_IMMEDIATE_KHR;
+  case PresentMode::Mailbox:
+    return VK_PRESENT_MODE_MAILBOX_KHR;
+  case PresentMode::FifoRelaxed:
+    return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+  case PresentMode::Fifo:
+  default:
+    return VK_PRESENT_MODE_FIFO_KHR;
+  }
+}
+
+// FIFO is the one mode every device supports
 VkPresentModeKHR
-Application::chooseSwapPresentMode(std::vector<VkPresentModeKHR> const &modes) {
+Application::chooseSwapPresentMode(std::vector<VkPresentModeKHR> const &modes,
+                                   PresentMode preferred) {
+  VkPresentModeKHR const wanted = toVkPresentMode(preferred);
   for (auto const &mode : modes) {
-    if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
+    if (mode == wanted)
       return mode;
   }
 
@@ -943,39 +2366,63 @@ Application::chooseSwapExtent(VkSurfaceCapabilitiesKHR const &capabilities,
   }
 }
 
-VkShaderModule Application::createShaderModule(std::vector<char> const &code,
-                                               VkDevice device) {
-  VkShaderModuleCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<uint32_t const *>(code.data());
+bool Application::isPipelineCacheCompatible(
+    void const *data, size_t size,
+    VkPhysicalDeviceProperties const &properties) {
+  VkPipelineCacheHeaderVersionOne header;
+  if (size < sizeof(header))
+    return false;
+  std::memcpy(&header, data, sizeof(header));
+
+  return header.headerSize >= sizeof(header) && header.headerSize <= size &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                     VK_UUID_SIZE) == 0;
+}
 
-  VkShaderModule shaderModule;
-  if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("Failed to create shader module");
+void Application::createValidationSink() {
+  // Each level reports itself and everything more severe
+  VkDebugUtilsMessageSeverityFlagsEXT severities =
+      VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+  switch (m_settings.validationLevel) {
+  case ValidationLevel::Verbose:
+    severities |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    [[fallthrough]];
+  case ValidationLevel::Info:
+    severities |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    [[fallthrough]];
+  case ValidationLevel::Warning:
+    severities |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+    [[fallthrough]];
+  case ValidationLevel::Error:
+    break;
   }
 
-  return shaderModule;
+  VkDebugUtilsMessageTypeFlagsEXT types =
+      VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+      VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+  if (m_settings.validationPerformance)
+    types |= VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+
+  m_validationSink = std::make_unique<ValidationSink>(
+      severities, types, m_settings.validationOutput);
 }
 
+// The messenger reports everything so the sink's filter can be changed at
+// runtime; what the sink filters out costs a bit test
 void Application::populateDebugMessengerCreateInfo(
     VkDebugUtilsMessengerCreateInfoEXT &createInfo) {
   createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
   createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+                               VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
                                VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
                                VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
   createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
                            VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
                            VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-  createInfo.pfnUserCallback = debugCallback;
-}
-
-VKAPI_ATTR VkBool32 VKAPI_CALL Application::debugCallback(
-    VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-    VkDebugUtilsMessageTypeFlagsEXT messageType,
-    const VkDebugUtilsMessengerCallbackDataEXT *callbackData, void *userData) {
-  std::cerr << "Validation layer: " << callbackData->pMessage << std::endl;
-  return VK_FALSE;
+  createInfo.pfnUserCallback = ValidationSink::callback;
+  createInfo.pUserData = m_validationSink.get();
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "ComputeScheduler.hpp"
+
+#include <stdexcept>
+
+ComputeScheduler::ComputeScheduler(VkDevice device, uint32_t computeFamily,
+                                   Timeline &computeTimeline,
+                                   Timeline &graphicsTimeline,
+                                   uint32_t framesInFlight)
+    : m_device(device), m_timeline(computeTimeline),
+      m_graphicsTimeline(graphicsTimeline), m_frames(framesInFlight) {
+  for (Frame &frame : m_frames) {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = computeFamily;
+
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr,
+                            &frame.commandPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create compute command pool");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = frame.commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(m_device, &allocInfo,
+                                 &frame.commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate compute command buffer");
+    }
+  }
+}
+
+ComputeScheduler::~ComputeScheduler() {
+  m_timeline.waitIdle();
+  for (Frame &frame : m_frames) {
+    vkDestroyCommandPool(m_device, frame.commandPool, nullptr);
+  }
+}
+
+void ComputeScheduler::addJob(VkPipelineStageFlags stages,
+                              RecordFunction record) {
+  m_jobs.push_back({stages, std::move(record)});
+}
+
+uint64_t ComputeScheduler::submit(uint32_t frame, uint64_t graphicsPoint) {
+  if (m_jobs.empty())
+    return 0;
+
+  Frame &f = m_frames[frame];
+
+  // Normally already reached, as the graphics work of this frame slot waited
+  // on the previous submission
+  m_timeline.wait(f.point);
+  vkResetCommandPool(m_device, f.commandPool, 0);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(f.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin recording compute commands");
+  }
+
+  VkPipelineStageFlags waitStages = 0;
+  for (Job const &job : m_jobs) {
+    job.record(f.commandBuffer);
+    waitStages |= job.stages;
+  }
+  m_jobs.clear();
+
+  if (vkEndCommandBuffer(f.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record compute commands");
+  }
+
+  Timeline::Submission submission;
+  submission.commandBuffers = {f.commandBuffer};
+  submission.waits = {{&m_graphicsTimeline, graphicsPoint, waitStages}};
+  f.point = m_timeline.submit(submission);
+  return f.point;
+}
@@ -0,0 +1,450 @@
+#include "CullingPass.hpp"
+
+#include "ShaderLibrary.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+VkDescriptorSetLayout
+createSetLayout(ObjectCache &objects,
+                std::vector<VkDescriptorType> const &descriptorTypes) {
+  std::vector<VkDescriptorSetLayoutBinding> bindings(descriptorTypes.size());
+  for (size_t i = 0; i < bindings.size(); i++) {
+    bindings[i].binding = static_cast<uint32_t>(i);
+    bindings[i].descriptorType = descriptorTypes[i];
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  return objects.acquire(layoutInfo);
+}
+
+VkPipelineLayout createPipelineLayout(ObjectCache &objects,
+                                      VkDescriptorSetLayout setLayout,
+                                      uint32_t pushConstantSize) {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = pushConstantSize;
+
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &setLayout;
+  layoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+  layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  return objects.acquire(layoutInfo);
+}
+
+uint32_t groupCount(uint32_t size, uint32_t groupSize) {
+  return (size + groupSize - 1) / groupSize;
+}
+
+} // namespace
+
+CullingPass::CullingPass(VkDevice device, MemoryAllocator &allocator,
+                         ObjectCache &objects, VkPipelineCache pipelineCache,
+                         IndirectScene const &scene, bool occlusion,
+                         bool asyncCompute,
+                         std::string const &shaderDirectory)
+    : m_device(device), m_allocator(allocator), m_objects(objects),
+      m_scene(scene),
+      m_occlusion(occlusion), m_asyncCompute(asyncCompute) {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  m_sampler = m_objects.acquire(samplerInfo);
+
+  createPipelines(pipelineCache, shaderDirectory);
+}
+
+CullingPass::~CullingPass() {
+  destroyPyramid(m_pyramid);
+
+  m_objects.release(m_cullPipeline);
+  m_objects.release(m_cullPipelineLayout);
+  m_objects.release(m_cullSetLayout);
+  m_objects.release(m_pyramidPipeline);
+  m_objects.release(m_pyramidPipelineLayout);
+  m_objects.release(m_pyramidSetLayout);
+  m_objects.release(m_sampler);
+}
+
+void CullingPass::resize(
+    VkImage depthImage, VkFormat depthFormat, VkExtent2D extent,
+    std::function<void(std::function<void()>)> const &retire) {
+  if (m_pyramid.image != VK_NULL_HANDLE) {
+    retire([this, pyramid = m_pyramid]() mutable { destroyPyramid(pyramid); });
+    m_pyramid = {};
+  }
+
+  // Level 0 is half the depth buffer, rounded up so no texel is lost
+  m_pyramid.extent = {std::max(1u, (extent.width + 1) / 2),
+                      std::max(1u, (extent.height + 1) / 2)};
+  uint32_t levelCount = 1;
+  while ((std::max(m_pyramid.extent.width, m_pyramid.extent.height) >>
+          levelCount) > 0) {
+    levelCount++;
+  }
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.extent = {m_pyramid.extent.width, m_pyramid.extent.height, 1};
+  imageInfo.mipLevels = levelCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  if (vkCreateImage(m_device, &imageInfo, nullptr, &m_pyramid.image) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth pyramid");
+  }
+  m_pyramid.allocation = m_allocator.allocateForImage(
+      m_pyramid.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  m_pyramid.levelViews.resize(levelCount);
+  createPyramidViews(depthImage, depthFormat);
+  createPyramidDescriptorSets();
+}
+
+void CullingPass::record(VkCommandBuffer commandBuffer,
+                         IndirectScene::View const &view,
+                         uint32_t output) const {
+  if (m_occlusion) {
+    recordPyramid(commandBuffer);
+  } else {
+    // Never sampled, but the cull dispatch still expects its layout
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_pyramid.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                                VK_REMAINING_MIP_LEVELS, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &barrier);
+  }
+
+  // The previous frame's draws must be done with the commands and the visible
+  // list before they are rewritten
+  if (!m_asyncCompute) {
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 0, nullptr);
+  }
+
+  VkBufferCopy region{};
+  region.size = m_scene.drawCount() * sizeof(VkDrawIndexedIndirectCommand);
+  vkCmdCopyBuffer(commandBuffer, m_scene.resetBuffer(),
+                  m_scene.indirectBuffer(output), 1, &region);
+
+  VkMemoryBarrier resetBarrier{};
+  resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  resetBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &resetBarrier, 0, nullptr, 0, nullptr);
+
+  CullParameters parameters{};
+  parameters.center[0] = view.center[0];
+  parameters.center[1] = view.center[1];
+  parameters.zoom = view.zoom;
+  parameters.instanceCount = m_scene.instanceCount();
+  parameters.pyramidSize[0] = static_cast<float>(m_pyramid.extent.width);
+  parameters.pyramidSize[1] = static_cast<float>(m_pyramid.extent.height);
+  parameters.pyramidLevels =
+      static_cast<uint32_t>(m_pyramid.levelViews.size());
+  parameters.occlusion = m_occlusion ? 1 : 0;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_cullPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_cullPipelineLayout, 0, 1,
+                          &m_pyramid.cullSets[output], 0, nullptr);
+  vkCmdPushConstants(commandBuffer, m_cullPipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParameters),
+                     &parameters);
+  vkCmdDispatch(commandBuffer, groupCount(m_scene.instanceCount(), 64), 1, 1);
+
+  if (m_asyncCompute)
+    return;
+
+  VkMemoryBarrier cullBarrier{};
+  cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  cullBarrier.dstAccessMask =
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                       0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+void CullingPass::createPipelines(VkPipelineCache pipelineCache,
+                                  std::string const &shaderDirectory) {
+  m_pyramidSetLayout = createSetLayout(
+      m_objects, {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                  VK_DESCRIPTOR_TYPE_STORAGE_IMAGE});
+  m_pyramidPipelineLayout =
+      createPipelineLayout(m_objects, m_pyramidSetLayout, 0);
+
+  m_cullSetLayout = createSetLayout(
+      m_objects,
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER});
+  m_cullPipelineLayout =
+      createPipelineLayout(m_objects, m_cullSetLayout, sizeof(CullParameters));
+
+  auto const acquireModule = [this,
+                              &shaderDirectory](std::string const &name) {
+    ShaderLibrary::Code const code = ShaderLibrary::load(name, shaderDirectory);
+    return m_objects.acquire(ShaderLibrary::moduleInfo(code));
+  };
+  VkShaderModule const pyramidModule = acquireModule("HiZ.comp");
+  VkShaderModule const cullModule = acquireModule("Cull.comp");
+
+  auto const pipelineInfo = [](VkShaderModule module,
+                               VkPipelineLayout layout) {
+    VkComputePipelineCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = module;
+    info.stage.pName = "main";
+    info.layout = layout;
+    return info;
+  };
+
+  VkComputePipelineCreateInfo const infos[2] = {
+      pipelineInfo(pyramidModule, m_pyramidPipelineLayout),
+      pipelineInfo(cullModule, m_cullPipelineLayout),
+  };
+
+  // The pipelines keep the modules alive for as long as they are cached
+  std::vector<VkPipeline> const pipelines =
+      m_objects.acquire(infos, 2, pipelineCache);
+  m_objects.release(cullModule);
+  m_objects.release(pyramidModule);
+
+  m_pyramidPipeline = pipelines[0];
+  m_cullPipeline = pipelines[1];
+}
+
+void CullingPass::createPyramidViews(VkImage depthImage, VkFormat depthFormat) {
+  auto const createView = [this](VkImage image, VkFormat format,
+                                 VkImageSubresourceRange range) {
+    VkImageViewCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    info.image = image;
+    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    info.format = format;
+    info.subresourceRange = range;
+
+    VkImageView view;
+    if (vkCreateImageView(m_device, &info, nullptr, &view) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create depth pyramid view");
+    }
+    return view;
+  };
+
+  uint32_t const levelCount =
+      static_cast<uint32_t>(m_pyramid.levelViews.size());
+
+  // Sampling a depth/stencil format needs a view with the depth aspect alone
+  m_pyramid.depthView = createView(depthImage, depthFormat,
+                                   {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1});
+  m_pyramid.view =
+      createView(m_pyramid.image, VK_FORMAT_R32_SFLOAT,
+                 {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1});
+  for (uint32_t i = 0; i < levelCount; i++) {
+    m_pyramid.levelViews[i] =
+        createView(m_pyramid.image, VK_FORMAT_R32_SFLOAT,
+                   {VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1});
+  }
+}
+
+void CullingPass::createPyramidDescriptorSets() {
+  uint32_t const levelCount =
+      static_cast<uint32_t>(m_pyramid.levelViews.size());
+  uint32_t const outputCount = m_scene.outputCount();
+
+  VkDescriptorPoolSize poolSizes[3] = {
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, levelCount + outputCount},
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelCount},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * outputCount},
+  };
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = levelCount + outputCount;
+  poolInfo.poolSizeCount = 3;
+  poolInfo.pPoolSizes = poolSizes;
+
+  if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr,
+                             &m_pyramid.descriptorPool) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor pool");
+  }
+
+  std::vector<VkDescriptorSetLayout> setLayouts(levelCount,
+                                                m_pyramidSetLayout);
+  setLayouts.insert(setLayouts.end(), outputCount, m_cullSetLayout);
+
+  std::vector<VkDescriptorSet> sets(setLayouts.size());
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = m_pyramid.descriptorPool;
+  allocInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+  allocInfo.pSetLayouts = setLayouts.data();
+
+  if (vkAllocateDescriptorSets(m_device, &allocInfo, sets.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate descriptor sets");
+  }
+  m_pyramid.cullSets.assign(sets.begin() + levelCount, sets.end());
+  sets.resize(levelCount);
+  m_pyramid.levelSets = std::move(sets);
+
+  // Each level reads the one below it, level 0 reads the depth buffer
+  std::vector<VkDescriptorImageInfo> inputs(levelCount);
+  std::vector<VkDescriptorImageInfo> outputs(levelCount);
+  std::vector<VkWriteDescriptorSet> writes;
+  for (uint32_t i = 0; i < levelCount; i++) {
+    inputs[i].sampler = m_sampler;
+    inputs[i].imageView =
+        i == 0 ? m_pyramid.depthView : m_pyramid.levelViews[i - 1];
+    inputs[i].imageLayout =
+        i == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+               : VK_IMAGE_LAYOUT_GENERAL;
+    outputs[i].imageView = m_pyramid.levelViews[i];
+    outputs[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_pyramid.levelSets[i];
+    write.descriptorCount = 1;
+
+    write.dstBinding = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &inputs[i];
+    writes.push_back(write);
+
+    write.dstBinding = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.pImageInfo = &outputs[i];
+    writes.push_back(write);
+  }
+
+  std::vector<VkDescriptorBufferInfo> buffers;
+  for (uint32_t i = 0; i < outputCount; i++) {
+    buffers.push_back({m_scene.instanceBuffer(), 0, VK_WHOLE_SIZE});
+    buffers.push_back({m_scene.indirectBuffer(i), 0, VK_WHOLE_SIZE});
+    buffers.push_back({m_scene.visibleBuffer(i), 0, VK_WHOLE_SIZE});
+  }
+  VkDescriptorImageInfo const pyramid = {m_sampler, m_pyramid.view,
+                                         VK_IMAGE_LAYOUT_GENERAL};
+
+  for (uint32_t i = 0; i < outputCount; i++) {
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_pyramid.cullSets[i];
+    write.dstBinding = 0;
+    write.descriptorCount = 3;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffers[3 * i];
+    writes.push_back(write);
+
+    write.dstBinding = 3;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pBufferInfo = nullptr;
+    write.pImageInfo = &pyramid;
+    writes.push_back(write);
+  }
+
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+}
+
+void CullingPass::destroyPyramid(Pyramid &pyramid) {
+  vkDestroyDescriptorPool(m_device, pyramid.descriptorPool, nullptr);
+  for (VkImageView view : pyramid.levelViews) {
+    vkDestroyImageView(m_device, view, nullptr);
+  }
+  vkDestroyImageView(m_device, pyramid.view, nullptr);
+  vkDestroyImageView(m_device, pyramid.depthView, nullptr);
+  vkDestroyImage(m_device, pyramid.image, nullptr);
+  if (pyramid.allocation.memory != VK_NULL_HANDLE) {
+    m_allocator.free(pyramid.allocation);
+  }
+  pyramid = {};
+}
+
+void CullingPass::recordPyramid(VkCommandBuffer commandBuffer) const {
+  // Last frame's cull dispatch has to finish sampling the old contents
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = m_pyramid.image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                              VK_REMAINING_MIP_LEVELS, 0, 1};
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_pyramidPipeline);
+
+  VkExtent2D extent = m_pyramid.extent;
+  for (size_t i = 0; i < m_pyramid.levelSets.size(); i++) {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            m_pyramidPipelineLayout, 0, 1,
+                            &m_pyramid.levelSets[i], 0, nullptr);
+    vkCmdDispatch(commandBuffer, groupCount(extent.width, 8),
+                  groupCount(extent.height, 8), 1);
+
+    // The next level, or the cull dispatch, reads this one
+    VkMemoryBarrier levelBarrier{};
+    levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &levelBarrier, 0, nullptr, 0, nullptr);
+
+    extent.width = std::max(1u, extent.width / 2);
+    extent.height = std::max(1u, extent.height / 2);
+  }
+}
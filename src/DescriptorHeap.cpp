@@ -0,0 +1,217 @@
+#include "DescriptorHeap.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+DescriptorHeap::DescriptorHeap(
+    VkDevice device, VkPhysicalDeviceDescriptorIndexingProperties const &limits,
+    Capacity capacity)
+    : m_device(device) {
+  capacity.buffers =
+      std::min({capacity.buffers,
+                limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                limits.maxDescriptorSetUpdateAfterBindStorageBuffers});
+  capacity.images =
+      std::min({capacity.images,
+                limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                limits.maxDescriptorSetUpdateAfterBindSampledImages});
+  capacity.samplers =
+      std::min({capacity.samplers,
+                limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+                limits.maxDescriptorSetUpdateAfterBindSamplers});
+  // Buffers and images also count against one shared limit per stage
+  uint32_t const resources = limits.maxPerStageUpdateAfterBindResources;
+  if (capacity.buffers + capacity.images > resources) {
+    capacity.buffers = std::min(capacity.buffers, resources / 2);
+    capacity.images = std::min(capacity.images, resources - capacity.buffers);
+  }
+  m_buffers.capacity = capacity.buffers;
+  m_images.capacity = capacity.images;
+  m_samplers.capacity = capacity.samplers;
+
+  VkDescriptorType const types[3] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                                     VK_DESCRIPTOR_TYPE_SAMPLER};
+  uint32_t const counts[3] = {capacity.buffers, capacity.images,
+                              capacity.samplers};
+
+  VkDescriptorSetLayoutBinding bindings[3] = {};
+  VkDescriptorBindingFlags bindingFlags[3] = {};
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (uint32_t i = 0; i < 3; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = types[i];
+    bindings[i].descriptorCount = counts[i];
+    bindings[i].stageFlags =
+        VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+    bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                      VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+                      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    if (counts[i] > 0)
+      poolSizes.push_back({types[i], counts[i]});
+  }
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+  flagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  flagsInfo.bindingCount = 3;
+  flagsInfo.pBindingFlags = bindingFlags;
+
+  // Not from the object cache, which takes no extension structures; there
+  // is only ever one heap
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &flagsInfo;
+  layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layoutInfo.bindingCount = 3;
+  layoutInfo.pBindings = bindings;
+
+  if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor heap layout");
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+
+  if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_pool) !=
+      VK_SUCCESS) {
+    vkDestroyDescriptorSetLayout(m_device, m_layout, nullptr);
+    throw std::runtime_error("Failed to create descriptor heap pool");
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = m_pool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &m_layout;
+
+  if (vkAllocateDescriptorSets(m_device, &allocInfo, &m_set) != VK_SUCCESS) {
+    vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_layout, nullptr);
+    throw std::runtime_error("Failed to allocate descriptor heap");
+  }
+}
+
+DescriptorHeap::~DescriptorHeap() {
+  vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+  vkDestroyDescriptorSetLayout(m_device, m_layout, nullptr);
+}
+
+VkDescriptorSetLayout DescriptorHeap::layout() const { return m_layout; }
+
+DescriptorHeap::Capacity DescriptorHeap::capacity() const {
+  return {m_buffers.capacity, m_images.capacity, m_samplers.capacity};
+}
+
+uint32_t DescriptorHeap::addBuffer(VkBuffer buffer, VkDeviceSize offset,
+                                   VkDeviceSize range) {
+  VkDescriptorBufferInfo bufferInfo{buffer, offset, range};
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  uint32_t const handle = allocate(m_buffers, "buffer");
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = m_set;
+  write.dstBinding = bufferBinding;
+  write.dstArrayElement = handle;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+  return handle;
+}
+
+uint32_t DescriptorHeap::addImage(VkImageView view, VkImageLayout layout) {
+  VkDescriptorImageInfo imageInfo{VK_NULL_HANDLE, view, layout};
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  uint32_t const handle = allocate(m_images, "image");
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = m_set;
+  write.dstBinding = imageBinding;
+  write.dstArrayElement = handle;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  write.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+  return handle;
+}
+
+uint32_t DescriptorHeap::addSampler(VkSampler sampler) {
+  VkDescriptorImageInfo imageInfo{sampler, VK_NULL_HANDLE,
+                                  VK_IMAGE_LAYOUT_UNDEFINED};
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  uint32_t const handle = allocate(m_samplers, "sampler");
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = m_set;
+  write.dstBinding = samplerBinding;
+  write.dstArrayElement = handle;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+  write.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+  return handle;
+}
+
+void DescriptorHeap::removeBuffer(uint32_t handle) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  release(m_buffers, handle, "buffer");
+}
+
+void DescriptorHeap::removeImage(uint32_t handle) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  release(m_images, handle, "image");
+}
+
+void DescriptorHeap::removeSampler(uint32_t handle) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  release(m_samplers, handle, "sampler");
+}
+
+void DescriptorHeap::bind(VkCommandBuffer commandBuffer,
+                          VkPipelineBindPoint bindPoint,
+                          VkPipelineLayout pipelineLayout) const {
+  vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, 0, 1,
+                          &m_set, 0, nullptr);
+}
+
+// The descriptor left in a freed slot stays until it's overwritten; being
+// partially bound, the set doesn't mind it going stale
+uint32_t DescriptorHeap::allocate(Slots &slots, char const *kind) {
+  uint32_t handle;
+  if (!slots.free.empty()) {
+    handle = slots.free.back();
+    slots.free.pop_back();
+  } else if (slots.used < slots.capacity) {
+    handle = slots.used++;
+    slots.live.push_back(false);
+  } else {
+    throw std::runtime_error(std::string("Descriptor heap is out of ") +
+                             kind + " slots");
+  }
+  slots.live[handle] = true;
+  return handle;
+}
+
+// Freeing a slot twice would hand it out to two resources
+void DescriptorHeap::release(Slots &slots, uint32_t handle, char const *kind) {
+  if (handle >= slots.used || !slots.live[handle]) {
+    throw std::runtime_error(std::string("Removing ") + kind + " handle " +
+                             std::to_string(handle) +
+                             ", which isn't in the descriptor heap");
+  }
+  slots.live[handle] = false;
+  slots.free.push_back(handle);
+}
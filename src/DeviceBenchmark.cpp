@@ -0,0 +1,254 @@
+#include "DeviceBenchmark.hpp"
+#include "Utils.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr VkDeviceSize bufferSize = VkDeviceSize(64) << 20;
+constexpr uint32_t copyCount = 8;
+
+void check(VkResult result, char const *what) {
+  if (result != VK_SUCCESS)
+    throw std::runtime_error(std::string("Failed to ") + what);
+}
+
+// Destroyed however far measuring got
+struct Resources {
+  VkDevice device = VK_NULL_HANDLE;
+  VkBuffer buffers[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+  VkDeviceMemory memory[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+
+  ~Resources() {
+    if (device == VK_NULL_HANDLE)
+      return;
+    vkDestroyQueryPool(device, queryPool, nullptr);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    for (int i = 0; i < 2; i++) {
+      vkDestroyBuffer(device, buffers[i], nullptr);
+      vkFreeMemory(device, memory[i], nullptr);
+    }
+    vkDestroyDevice(device, nullptr);
+  }
+};
+
+} // namespace
+
+DeviceBenchmark::DeviceBenchmark(std::string cachePath)
+    : m_cachePath(std::move(cachePath)) {
+  if (m_cachePath.empty())
+    return;
+  std::optional<std::string> text = Utils::readText(m_cachePath);
+  if (!text)
+    return;
+
+  // One "<key> <GB/s>" line per device
+  std::istringstream lines(*text);
+  std::string key;
+  double bandwidth;
+  while (lines >> key >> bandwidth) {
+    m_results[key] = bandwidth;
+  }
+}
+
+std::optional<double>
+DeviceBenchmark::copyBandwidth(DeviceCapabilities const &device) {
+  std::string const deviceKey = key(device);
+  if (auto found = m_results.find(deviceKey); found != m_results.end())
+    return found->second;
+
+  try {
+    double const bandwidth = measure(device);
+    m_results[deviceKey] = bandwidth;
+    m_changed = true;
+    return bandwidth;
+  } catch (std::exception const &e) {
+    std::cerr << "Benchmarking " << device.properties.deviceName
+              << " failed: " << e.what() << std::endl;
+    return std::nullopt;
+  }
+}
+
+void DeviceBenchmark::save() const {
+  if (!m_changed || m_cachePath.empty())
+    return;
+
+  std::ostringstream text;
+  for (auto const &[key, bandwidth] : m_results) {
+    text << key << ' ' << bandwidth << '\n';
+  }
+  std::string const data = text.str();
+  Utils::writeFileAtomic(m_cachePath, data.data(), data.size());
+}
+
+std::string DeviceBenchmark::key(DeviceCapabilities const &device) {
+  std::ostringstream key;
+  key << std::hex << std::setfill('0');
+  for (uint8_t byte : device.deviceUUID) {
+    key << std::setw(2) << static_cast<uint32_t>(byte);
+  }
+  key << '-' << device.properties.driverVersion;
+  return key.str();
+}
+
+double DeviceBenchmark::measure(DeviceCapabilities const &device) {
+  // The family the renderer will draw on, as long as it can be timed
+  std::optional<uint32_t> family;
+  for (uint32_t i = 0; i < device.queueFamilies.size(); i++) {
+    VkQueueFamilyProperties const &properties = device.queueFamilies[i];
+    if ((properties.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+        properties.timestampValidBits > 0) {
+      family = i;
+      break;
+    }
+  }
+  if (!family)
+    throw std::runtime_error("No graphics queue with timestamps");
+
+  Resources resources;
+
+  float const queuePriority = 1.0f;
+  VkDeviceQueueCreateInfo queueInfo{};
+  queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queueInfo.queueFamilyIndex = *family;
+  queueInfo.queueCount = 1;
+  queueInfo.pQueuePriorities = &queuePriority;
+
+  VkDeviceCreateInfo deviceInfo{};
+  deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  deviceInfo.queueCreateInfoCount = 1;
+  deviceInfo.pQueueCreateInfos = &queueInfo;
+  check(vkCreateDevice(device.physicalDevice, &deviceInfo, nullptr,
+                       &resources.device),
+        "create device");
+  VkDevice const logicalDevice = resources.device;
+
+  VkQueue queue;
+  vkGetDeviceQueue(logicalDevice, *family, 0, &queue);
+
+  for (int i = 0; i < 2; i++) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    check(vkCreateBuffer(logicalDevice, &bufferInfo, nullptr,
+                         &resources.buffers[i]),
+          "create buffer");
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(logicalDevice, resources.buffers[i],
+                                  &requirements);
+    std::optional<uint32_t> memoryType;
+    for (uint32_t type = 0; type < device.memory.memoryTypeCount; type++) {
+      if ((requirements.memoryTypeBits & (1u << type)) &&
+          (device.memory.memoryTypes[type].propertyFlags &
+           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+        memoryType = type;
+        break;
+      }
+    }
+    if (!memoryType)
+      throw std::runtime_error("No device-local memory for buffers");
+
+    VkMemoryAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = *memoryType;
+    check(vkAllocateMemory(logicalDevice, &allocateInfo, nullptr,
+                           &resources.memory[i]),
+          "allocate memory");
+    check(vkBindBufferMemory(logicalDevice, resources.buffers[i],
+                             resources.memory[i], 0),
+          "bind buffer memory");
+  }
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = *family;
+  check(vkCreateCommandPool(logicalDevice, &poolInfo, nullptr,
+                            &resources.commandPool),
+        "create command pool");
+
+  VkQueryPoolCreateInfo queryInfo{};
+  queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryInfo.queryCount = 2;
+  check(vkCreateQueryPool(logicalDevice, &queryInfo, nullptr,
+                          &resources.queryPool),
+        "create query pool");
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = resources.commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  VkCommandBuffer commandBuffer;
+  check(vkAllocateCommandBuffers(logicalDevice, &allocInfo, &commandBuffer),
+        "allocate command buffer");
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  check(vkBeginCommandBuffer(commandBuffer, &beginInfo),
+        "begin command buffer");
+
+  VkBufferCopy const region{0, 0, bufferSize};
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  vkCmdResetQueryPool(commandBuffer, resources.queryPool, 0, 2);
+  // Copies back and forth; the one before the first timestamp wakes the
+  // device up, and a timestamp at the transfer stage waits for it
+  for (uint32_t copy = 0; copy <= copyCount; copy++) {
+    if (copy == 1) {
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                          resources.queryPool, 0);
+    }
+    vkCmdCopyBuffer(commandBuffer, resources.buffers[copy % 2],
+                    resources.buffers[(copy + 1) % 2], 1, &region);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      resources.queryPool, 1);
+  check(vkEndCommandBuffer(commandBuffer), "record command buffer");
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+  check(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE),
+        "submit copies");
+  check(vkQueueWaitIdle(queue), "wait for copies");
+
+  uint64_t timestamps[2];
+  check(vkGetQueryPoolResults(logicalDevice, resources.queryPool, 0, 2,
+                              sizeof(timestamps), timestamps, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT |
+                                  VK_QUERY_RESULT_WAIT_BIT),
+        "read timestamps");
+
+  uint32_t const validBits = device.queueFamilies[*family].timestampValidBits;
+  uint64_t const mask =
+      validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+  double const nanoseconds =
+      static_cast<double>((timestamps[1] - timestamps[0]) & mask) *
+      device.properties.limits.timestampPeriod;
+  if (nanoseconds <= 0.0)
+    throw std::runtime_error("Copies took no measurable time");
+
+  // Bytes per nanosecond are GB/s
+  return static_cast<double>(bufferSize * copyCount) / nanoseconds;
+}
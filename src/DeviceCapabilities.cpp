@@ -0,0 +1,146 @@
+#include "DeviceCapabilities.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+DeviceCapabilities DeviceCapabilities::query(VkPhysicalDevice physicalDevice,
+                                             VkSurfaceKHR surface,
+                                             uint32_t instanceApiVersion) {
+  DeviceCapabilities capabilities;
+  capabilities.physicalDevice = physicalDevice;
+
+  // Core in Vulkan 1.1, which the instance asks for
+  VkPhysicalDeviceIDProperties idProperties{};
+  idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &idProperties;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+  capabilities.properties = properties.properties;
+  capabilities.apiVersion =
+      std::min(instanceApiVersion, properties.properties.apiVersion);
+  std::memcpy(capabilities.deviceUUID.data(), idProperties.deviceUUID,
+              VK_UUID_SIZE);
+
+  vkGetPhysicalDeviceFeatures(physicalDevice, &capabilities.features);
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &capabilities.memory);
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           nullptr);
+  capabilities.queueFamilies.resize(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      physicalDevice, &queueFamilyCount, capabilities.queueFamilies.data());
+
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount,
+                                       nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount,
+                                       extensions.data());
+  for (VkExtensionProperties const &extension : extensions) {
+    capabilities.extensions.insert(extension.extensionName);
+  }
+
+  // Features of extensions and newer versions, each chained only when the
+  // device knows about it
+  bool const vulkan12 = capabilities.apiVersion >= VK_API_VERSION_1_2;
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+  timelineFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+  if (vulkan12 ||
+      capabilities.hasExtensions({VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME})) {
+    timelineFeatures.pNext = features.pNext;
+    features.pNext = &timelineFeatures;
+  }
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  if (vulkan12 &&
+      capabilities.hasExtensions({VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME})) {
+    dynamicRenderingFeatures.pNext = features.pNext;
+    features.pNext = &dynamicRenderingFeatures;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+  indexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  if (vulkan12 ||
+      capabilities.hasExtensions({VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME})) {
+    indexingFeatures.pNext = features.pNext;
+    features.pNext = &indexingFeatures;
+  }
+
+  if (features.pNext != nullptr)
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+  capabilities.timelineSemaphore =
+      timelineFeatures.timelineSemaphore == VK_TRUE;
+  capabilities.dynamicRendering =
+      dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+  capabilities.descriptorIndexing =
+      capabilities.features.shaderStorageBufferArrayDynamicIndexing &&
+      capabilities.features.shaderSampledImageArrayDynamicIndexing &&
+      indexingFeatures.runtimeDescriptorArray &&
+      indexingFeatures.descriptorBindingPartiallyBound &&
+      indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+      indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+      indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+
+  if (capabilities.descriptorIndexing) {
+    capabilities.descriptorIndexingProperties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    indexingProperties.pNext = &capabilities.descriptorIndexingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &indexingProperties);
+  }
+
+  if (surface == VK_NULL_HANDLE)
+    return capabilities;
+
+  for (uint32_t i = 0; i < queueFamilyCount; i++) {
+    VkBool32 presentSupport = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface,
+                                         &presentSupport);
+    capabilities.presentSupport.push_back(presentSupport == VK_TRUE);
+  }
+
+  uint32_t formatCount = 0;
+  vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount,
+                                       nullptr);
+  capabilities.surfaceFormats.resize(formatCount);
+  vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount,
+                                       capabilities.surfaceFormats.data());
+
+  uint32_t presentModeCount = 0;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface,
+                                            &presentModeCount, nullptr);
+  capabilities.presentModes.resize(presentModeCount);
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface,
+                                            &presentModeCount,
+                                            capabilities.presentModes.data());
+
+  return capabilities;
+}
+
+bool DeviceCapabilities::hasExtensions(
+    std::vector<char const *> const &names) const {
+  for (char const *name : names) {
+    if (extensions.count(name) == 0)
+      return false;
+  }
+  return true;
+}
+
+VkDeviceSize DeviceCapabilities::deviceLocalMemory() const {
+  VkDeviceSize size = 0;
+  for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+    if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+      size += memory.memoryHeaps[i].size;
+  }
+  return size;
+}
@@ -0,0 +1,88 @@
+#include "FramePacer.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Left to spin rather than sleep through; covers the scheduler's usual
+// wake-up delay
+constexpr std::chrono::microseconds spinMargin{1000};
+
+double milliseconds(FramePacer::Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// `values` sorted ascending
+double percentile(std::vector<double> const &values, double fraction) {
+  size_t const index = static_cast<size_t>(fraction * (values.size() - 1));
+  return values[index];
+}
+
+} // namespace
+
+FramePacer::FramePacer(double framesPerSecond, size_t historyLength)
+    : m_historyLength(historyLength) {
+  if (framesPerSecond > 0.0) {
+    m_interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / framesPerSecond));
+  }
+}
+
+void FramePacer::beginFrame() {
+  if (m_interval != Clock::duration::zero()) {
+    Clock::time_point now = Clock::now();
+    // A frame that ran long moves the schedule instead of being made up for
+    // with a burst of frames
+    if (m_deadline < now - m_interval)
+      m_deadline = now;
+
+    if (m_deadline - now > spinMargin)
+      std::this_thread::sleep_until(m_deadline - spinMargin);
+    while (Clock::now() < m_deadline) {
+      std::this_thread::yield();
+    }
+    m_deadline += m_interval;
+  }
+
+  m_previousFrameStart = m_frameStart;
+  m_frameStart = Clock::now();
+}
+
+void FramePacer::endFrame() {
+  // The first frame has no interval to go with it
+  if (m_previousFrameStart == Clock::time_point{})
+    return;
+
+  m_history.push_back({milliseconds(Clock::now() - m_frameStart),
+                       milliseconds(m_frameStart - m_previousFrameStart)});
+  if (m_history.size() > m_historyLength)
+    m_history.pop_front();
+}
+
+void FramePacer::writeSummary(std::ostream &stream) const {
+  if (m_history.empty())
+    return;
+
+  std::vector<double> latencies;
+  std::vector<double> intervals;
+  for (Sample const &sample : m_history) {
+    latencies.push_back(sample.latencyMs);
+    intervals.push_back(sample.intervalMs);
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::sort(intervals.begin(), intervals.end());
+
+  stream << "Frame pacing (last " << m_history.size() << " frames):\n"
+         << std::fixed << std::setprecision(3);
+  for (auto const &[name, values] :
+       {std::pair{"latency", &latencies}, std::pair{"interval", &intervals}}) {
+    stream << '\t' << std::left << std::setw(16) << name << std::right
+           << " p50 " << percentile(*values, 0.5) << " ms, p99 "
+           << percentile(*values, 0.99) << " ms, max " << values->back()
+           << " ms\n";
+  }
+  stream << std::defaultfloat;
+}
@@ -0,0 +1,342 @@
+#include "GpuProfiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+VkQueryPipelineStatisticFlags const statisticFlags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+// Number of counters selected by statisticFlags
+uint32_t const statisticValueCount = 7;
+
+} // namespace
+
+GpuProfiler::GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device,
+                         uint32_t queueFamilyIndex, uint32_t slotCount,
+                         bool pipelineStatistics, uint32_t maxPasses,
+                         size_t historyLength)
+    : m_device(device), m_maxPasses(maxPasses),
+      m_historyLength(historyLength), m_pipelineStatistics(pipelineStatistics) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           queueFamilies.data());
+
+  uint32_t const validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+  if (validBits == 0) {
+    throw std::runtime_error("Queue family does not support timestamps");
+  }
+  m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+  m_timestampPeriod = properties.limits.timestampPeriod;
+
+  growSlots(slotCount);
+}
+
+void GpuProfiler::growSlots(uint32_t slotCount) {
+  while (m_slots.size() < slotCount) {
+    Slot &slot = m_slots.emplace_back();
+
+    VkQueryPoolCreateInfo timestampInfo{};
+    timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    timestampInfo.queryCount = m_maxPasses * 2;
+
+    if (vkCreateQueryPool(m_device, &timestampInfo, nullptr,
+                          &slot.timestampPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create timestamp query pool");
+    }
+
+    if (!m_pipelineStatistics)
+      continue;
+
+    VkQueryPoolCreateInfo statisticsInfo{};
+    statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    statisticsInfo.queryCount = m_maxPasses;
+    statisticsInfo.pipelineStatistics = statisticFlags;
+
+    if (vkCreateQueryPool(m_device, &statisticsInfo, nullptr,
+                          &slot.statisticsPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create statistics query pool");
+    }
+  }
+}
+
+GpuProfiler::~GpuProfiler() {
+  for (Slot const &slot : m_slots) {
+    vkDestroyQueryPool(m_device, slot.timestampPool, nullptr);
+    vkDestroyQueryPool(m_device, slot.statisticsPool, nullptr);
+  }
+}
+
+uint32_t GpuProfiler::slotCount() const {
+  return static_cast<uint32_t>(m_slots.size());
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::pipelineStatisticFlags() const {
+  return m_pipelineStatistics ? statisticFlags : 0;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot) {
+  Slot &s = m_slots[slot];
+  s.passes.clear();
+  s.passOpen = false;
+
+  vkCmdResetQueryPool(commandBuffer, s.timestampPool, 0, m_maxPasses * 2);
+  if (m_pipelineStatistics) {
+    vkCmdResetQueryPool(commandBuffer, s.statisticsPool, 0, m_maxPasses);
+  }
+}
+
+void GpuProfiler::beginPass(VkCommandBuffer commandBuffer, uint32_t slot,
+                            std::string const &name) {
+  Slot &s = m_slots[slot];
+  if (s.passOpen) {
+    throw std::runtime_error("Profiled passes cannot be nested");
+  }
+  if (s.passes.size() >= m_maxPasses) {
+    throw std::runtime_error("Too many profiled passes in one frame");
+  }
+
+  uint32_t const index = static_cast<uint32_t>(s.passes.size());
+  s.passes.push_back(name);
+  s.passOpen = true;
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      s.timestampPool, index * 2);
+  if (m_pipelineStatistics) {
+    vkCmdBeginQuery(commandBuffer, s.statisticsPool, index, 0);
+  }
+}
+
+void GpuProfiler::endPass(VkCommandBuffer commandBuffer, uint32_t slot) {
+  Slot &s = m_slots[slot];
+  if (!s.passOpen) {
+    throw std::runtime_error("No profiled pass to end");
+  }
+
+  uint32_t const index = static_cast<uint32_t>(s.passes.size()) - 1;
+  s.passOpen = false;
+
+  if (m_pipelineStatistics) {
+    vkCmdEndQuery(commandBuffer, s.statisticsPool, index);
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      s.timestampPool, index * 2 + 1);
+}
+
+void GpuProfiler::markSubmitted(uint32_t slot) {
+  Slot &s = m_slots[slot];
+  s.frame = m_frameCounter++;
+  s.pending = true;
+}
+
+void GpuProfiler::collectAll() {
+  std::vector<uint32_t> order(m_slots.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return m_slots[a].frame < m_slots[b].frame;
+  });
+
+  for (uint32_t slot : order) {
+    collect(slot);
+  }
+}
+
+void GpuProfiler::collect(uint32_t slot) {
+  Slot &s = m_slots[slot];
+  if (!s.pending || s.passes.empty())
+    return;
+  s.pending = false;
+
+  uint32_t const passCount = static_cast<uint32_t>(s.passes.size());
+
+  // Each timestamp is followed by its availability word
+  std::vector<uint64_t> timestamps(passCount * 2 * 2);
+  VkResult result = vkGetQueryPoolResults(
+      m_device, s.timestampPool, 0, passCount * 2,
+      timestamps.size() * sizeof(uint64_t), timestamps.data(),
+      2 * sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if (result != VK_SUCCESS && result != VK_NOT_READY)
+    return;
+
+  uint32_t const statisticsStride = statisticValueCount + 1;
+  std::vector<uint64_t> statistics(passCount * statisticsStride);
+  bool statisticsAvailable = false;
+  if (m_pipelineStatistics) {
+    result = vkGetQueryPoolResults(
+        m_device, s.statisticsPool, 0, passCount,
+        statistics.size() * sizeof(uint64_t), statistics.data(),
+        statisticsStride * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    statisticsAvailable = result == VK_SUCCESS || result == VK_NOT_READY;
+  }
+
+  for (uint32_t i = 0; i < passCount; i++) {
+    uint64_t const *begin = &timestamps[i * 4];
+    uint64_t const *end = &timestamps[i * 4 + 2];
+    if (begin[1] == 0 || end[1] == 0)
+      continue;
+
+    uint64_t const ticks = ((end[0] & m_timestampMask) -
+                            (begin[0] & m_timestampMask)) &
+                           m_timestampMask;
+
+    Sample sample{};
+    sample.frame = s.frame;
+    sample.milliseconds = ticks * m_timestampPeriod / 1e6;
+
+    uint64_t const *values = &statistics[i * statisticsStride];
+    if (statisticsAvailable && values[statisticValueCount] != 0) {
+      // Values come back in the bit order of the enabled statistics
+      sample.statistics.inputAssemblyVertices = values[0];
+      sample.statistics.inputAssemblyPrimitives = values[1];
+      sample.statistics.vertexShaderInvocations = values[2];
+      sample.statistics.clippingInvocations = values[3];
+      sample.statistics.clippingPrimitives = values[4];
+      sample.statistics.fragmentShaderInvocations = values[5];
+      sample.statistics.computeShaderInvocations = values[6];
+    }
+
+    std::deque<Sample> &history = m_history[s.passes[i]];
+    history.push_back(sample);
+    if (history.size() > m_historyLength) {
+      history.pop_front();
+    }
+  }
+}
+
+std::vector<std::string> GpuProfiler::passNames() const {
+  std::vector<std::string> names;
+  for (auto const &[name, history] : m_history) {
+    names.push_back(name);
+  }
+  return names;
+}
+
+std::vector<GpuProfiler::Sample>
+GpuProfiler::history(std::string const &pass) const {
+  auto const it = m_history.find(pass);
+  if (it == m_history.end())
+    return {};
+  return std::vector<Sample>(it->second.begin(), it->second.end());
+}
+
+double GpuProfiler::averageMilliseconds(std::string const &pass) const {
+  auto const it = m_history.find(pass);
+  if (it == m_history.end() || it->second.empty())
+    return 0.0;
+
+  double const total = std::accumulate(
+      it->second.begin(), it->second.end(), 0.0,
+      [](double sum, Sample const &sample) { return sum + sample.milliseconds; });
+  return total / it->second.size();
+}
+
+double GpuProfiler::minMilliseconds(std::string const &pass) const {
+  auto const it = m_history.find(pass);
+  if (it == m_history.end() || it->second.empty())
+    return 0.0;
+
+  return std::min_element(it->second.begin(), it->second.end(),
+                          [](Sample const &a, Sample const &b) {
+                            return a.milliseconds < b.milliseconds;
+                          })
+      ->milliseconds;
+}
+
+double GpuProfiler::maxMilliseconds(std::string const &pass) const {
+  auto const it = m_history.find(pass);
+  if (it == m_history.end() || it->second.empty())
+    return 0.0;
+
+  return std::max_element(it->second.begin(), it->second.end(),
+                          [](Sample const &a, Sample const &b) {
+                            return a.milliseconds < b.milliseconds;
+                          })
+      ->milliseconds;
+}
+
+void GpuProfiler::writeCsv(std::ostream &stream) const {
+  stream << "pass,frame,gpu_ms,ia_vertices,ia_primitives,vs_invocations,"
+            "clipping_invocations,clipping_primitives,fs_invocations,"
+            "cs_invocations\n";
+
+  for (auto const &[name, history] : m_history) {
+    for (Sample const &sample : history) {
+      PipelineStatistics const &stats = sample.statistics;
+      stream << name << ',' << sample.frame << ',' << sample.milliseconds << ','
+             << stats.inputAssemblyVertices << ','
+             << stats.inputAssemblyPrimitives << ','
+             << stats.vertexShaderInvocations << ','
+             << stats.clippingInvocations << ',' << stats.clippingPrimitives
+             << ',' << stats.fragmentShaderInvocations << ','
+             << stats.computeShaderInvocations << '\n';
+    }
+  }
+}
+
+void GpuProfiler::writeJson(std::ostream &stream) const {
+  stream << "{\n  \"passes\": [";
+
+  bool firstPass = true;
+  for (auto const &[name, history] : m_history) {
+    stream << (firstPass ? "\n" : ",\n");
+    firstPass = false;
+
+    stream << "    {\n"
+           << "      \"name\": \"" << name << "\",\n"
+           << "      \"averageMs\": " << averageMilliseconds(name) << ",\n"
+           << "      \"minMs\": " << minMilliseconds(name) << ",\n"
+           << "      \"maxMs\": " << maxMilliseconds(name) << ",\n"
+           << "      \"samples\": [";
+
+    bool firstSample = true;
+    for (Sample const &sample : history) {
+      PipelineStatistics const &stats = sample.statistics;
+      stream << (firstSample ? "\n" : ",\n");
+      firstSample = false;
+
+      stream << "        {\"frame\": " << sample.frame
+             << ", \"gpuMs\": " << sample.milliseconds
+             << ", \"iaVertices\": " << stats.inputAssemblyVertices
+             << ", \"iaPrimitives\": " << stats.inputAssemblyPrimitives
+             << ", \"vsInvocations\": " << stats.vertexShaderInvocations
+             << ", \"clippingInvocations\": " << stats.clippingInvocations
+             << ", \"clippingPrimitives\": " << stats.clippingPrimitives
+             << ", \"fsInvocations\": " << stats.fragmentShaderInvocations
+             << ", \"csInvocations\": " << stats.computeShaderInvocations
+             << "}";
+    }
+    stream << "\n      ]\n    }";
+  }
+
+  stream << "\n  ]\n}\n";
+}
+
+void GpuProfiler::writeSummary(std::ostream &stream) const {
+  stream << "GPU pass timings (last " << m_historyLength << " frames):\n";
+  for (auto const &[name, history] : m_history) {
+    stream << '\t' << std::left << std::setw(16) << name << std::right
+           << std::fixed << std::setprecision(3) << " avg "
+           << averageMilliseconds(name) << " ms, min " << minMilliseconds(name)
+           << " ms, max " << maxMilliseconds(name) << " ms\n";
+  }
+  stream << std::defaultfloat;
+}
@@ -0,0 +1,373 @@
+#include "IndirectScene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+struct Vertex {
+  float position[2];
+};
+
+// Triangle, quad and hexagon, packed into one vertex and one index buffer
+std::vector<Vertex> const vertices = {
+    {{0.0f, -0.5f}},    {{0.5f, 0.5f}},      {{-0.5f, 0.5f}},
+
+    {{-0.5f, -0.5f}},   {{0.5f, -0.5f}},     {{0.5f, 0.5f}},
+    {{-0.5f, 0.5f}},
+
+    {{0.0f, 0.0f}},     {{0.5f, 0.0f}},      {{0.25f, 0.433f}},
+    {{-0.25f, 0.433f}}, {{-0.5f, 0.0f}},     {{-0.25f, -0.433f}},
+    {{0.25f, -0.433f}},
+};
+
+std::vector<uint16_t> const indices = {
+    0, 1, 2,
+
+    0, 1, 2, 2, 3, 0,
+
+    0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 5, 0, 5, 6, 0, 6, 1,
+};
+
+} // namespace
+
+IndirectScene::IndirectScene(
+    VkDevice device, MemoryAllocator &allocator, ObjectCache &objects,
+    UploadManager &uploads, DescriptorHeap *heap, uint32_t instanceCount,
+    bool multiDrawIndirect,
+    PFN_vkCmdDrawIndexedIndirectCountKHR drawIndirectCount,
+    std::vector<uint32_t> const &cullingFamilies, uint32_t outputCount)
+    : m_device(device), m_allocator(allocator), m_objects(objects),
+      m_heap(heap), m_instanceCount(instanceCount),
+      m_multiDrawIndirect(multiDrawIndirect),
+      m_drawIndirectCount(drawIndirectCount), m_outputs(outputCount) {
+  std::vector<Mesh> const meshes = {
+      {0, 3, 0, 0.71f}, {3, 6, 3, 0.71f}, {9, 18, 7, 0.5f}};
+
+  // Spread instances over the screen, shrinking them as their number grows
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::uniform_int_distribution<uint32_t> byte(0, 255);
+  float const scale = std::min(1.0f, 2.0f / std::sqrt(float(instanceCount)));
+  bool const single = instanceCount == 1;
+
+  // One command per mesh, each drawing a contiguous range of instances
+  std::vector<Instance> instances(instanceCount);
+  std::vector<VkDrawIndexedIndirectCommand> commands;
+  uint32_t firstInstance = 0;
+  for (size_t i = 0; i < meshes.size(); i++) {
+    uint32_t const count = static_cast<uint32_t>(
+        (uint64_t(instanceCount) * (i + 1)) / meshes.size() - firstInstance);
+
+    for (uint32_t j = firstInstance; j < firstInstance + count; j++) {
+      Instance &instance = instances[j];
+      instance.offset[0] = single ? 0.0f : unit(random) * 2.0f - 1.0f;
+      instance.offset[1] = single ? 0.0f : unit(random) * 2.0f - 1.0f;
+      instance.scale = scale;
+      instance.rotation = single ? 0.0f : unit(random) * 6.2831853f;
+      instance.depth = single ? 0.5f : unit(random);
+      instance.radius = scale * meshes[i].radius;
+      instance.color = single ? 0xff0000ffu
+                              : byte(random) | byte(random) << 8 |
+                                    byte(random) << 16 | 0xff000000u;
+      instance.mesh = static_cast<uint32_t>(i);
+    }
+
+    VkDrawIndexedIndirectCommand command{};
+    command.indexCount = meshes[i].indexCount;
+    command.instanceCount = count;
+    command.firstIndex = meshes[i].firstIndex;
+    command.vertexOffset = meshes[i].vertexOffset;
+    command.firstInstance = firstInstance;
+    commands.push_back(command);
+
+    firstInstance += count;
+  }
+  m_drawCount = static_cast<uint32_t>(commands.size());
+
+  std::vector<VkDrawIndexedIndirectCommand> resetCommands = commands;
+  for (VkDrawIndexedIndirectCommand &command : resetCommands) {
+    command.instanceCount = 0;
+  }
+
+  std::vector<uint32_t> visible(instanceCount);
+  for (uint32_t i = 0; i < instanceCount; i++) {
+    visible[i] = i;
+  }
+
+  VkDeviceSize const vertexSize = vertices.size() * sizeof(Vertex);
+  VkDeviceSize const indexSize = indices.size() * sizeof(uint16_t);
+  VkDeviceSize const instanceSize =
+      std::max<size_t>(instances.size(), 1) * sizeof(Instance);
+  VkDeviceSize const visibleSize =
+      std::max<size_t>(visible.size(), 1) * sizeof(uint32_t);
+  VkDeviceSize const indirectSize =
+      commands.size() * sizeof(VkDrawIndexedIndirectCommand);
+
+  // Culling on another queue family reads and writes these from there too.
+  // The transfer family fills them, so it shares them as well.
+  std::vector<uint32_t> shared;
+  if (cullingFamilies.size() > 1) {
+    shared = cullingFamilies;
+    if (std::find(shared.begin(), shared.end(), uploads.transferFamily()) ==
+        shared.end()) {
+      shared.push_back(uploads.transferFamily());
+    }
+  }
+  bool const concurrent = !shared.empty();
+
+  m_vertexBuffer = createBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  m_indexBuffer = createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  m_instanceBuffer =
+      createBuffer(instanceSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, shared);
+  m_countBuffer = createBuffer(sizeof(uint32_t),
+                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_resetBuffer =
+      createBuffer(indirectSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, shared);
+  for (Output &output : m_outputs) {
+    output.indirectBuffer = createBuffer(indirectSize,
+                                         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                         shared);
+    output.visibleBuffer =
+        createBuffer(visibleSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, shared);
+  }
+
+  uploads.uploadBuffer(m_vertexBuffer.buffer, 0, vertices.data(), vertexSize);
+  uploads.uploadBuffer(m_indexBuffer.buffer, 0, indices.data(), indexSize);
+  if (!instances.empty()) {
+    uploads.uploadBuffer(m_instanceBuffer.buffer, 0, instances.data(),
+                         instances.size() * sizeof(Instance), concurrent);
+  }
+  for (Output const &output : m_outputs) {
+    if (!visible.empty()) {
+      uploads.uploadBuffer(output.visibleBuffer.buffer, 0, visible.data(),
+                           visible.size() * sizeof(uint32_t), concurrent);
+    }
+    uploads.uploadBuffer(output.indirectBuffer.buffer, 0, commands.data(),
+                         indirectSize, concurrent);
+  }
+  uploads.uploadBuffer(m_countBuffer.buffer, 0, &m_drawCount,
+                       sizeof(uint32_t));
+  uploads.uploadBuffer(m_resetBuffer.buffer, 0, resetCommands.data(),
+                       indirectSize, concurrent);
+
+  // Loading blocks until the scene is resident
+  uploads.waitIdle();
+
+  if (m_heap) {
+    m_instanceHandle = m_heap->addBuffer(m_instanceBuffer.buffer);
+    for (Output &output : m_outputs) {
+      output.visibleHandle = m_heap->addBuffer(output.visibleBuffer.buffer);
+    }
+  } else {
+    createDescriptorSets();
+  }
+}
+
+IndirectScene::~IndirectScene() {
+  if (m_heap) {
+    for (Output const &output : m_outputs) {
+      m_heap->removeBuffer(output.visibleHandle);
+    }
+    m_heap->removeBuffer(m_instanceHandle);
+  }
+  vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+  m_objects.release(m_descriptorSetLayout);
+
+  for (Output &output : m_outputs) {
+    destroyBuffer(output.visibleBuffer);
+    destroyBuffer(output.indirectBuffer);
+  }
+  destroyBuffer(m_resetBuffer);
+  destroyBuffer(m_countBuffer);
+  destroyBuffer(m_instanceBuffer);
+  destroyBuffer(m_indexBuffer);
+  destroyBuffer(m_vertexBuffer);
+}
+
+std::vector<VkVertexInputBindingDescription> IndirectScene::vertexBindings() {
+  VkVertexInputBindingDescription binding{};
+  binding.binding = 0;
+  binding.stride = sizeof(Vertex);
+  binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  return {binding};
+}
+
+std::vector<VkVertexInputAttributeDescription>
+IndirectScene::vertexAttributes() {
+  VkVertexInputAttributeDescription position{};
+  position.location = 0;
+  position.binding = 0;
+  position.format = VK_FORMAT_R32G32_SFLOAT;
+  position.offset = 0;
+  return {position};
+}
+
+VkDescriptorSetLayout IndirectScene::descriptorSetLayout() const {
+  return m_descriptorSetLayout;
+}
+
+uint32_t IndirectScene::pushConstantSize() const {
+  return m_heap ? sizeof(BindlessView) : sizeof(View);
+}
+
+uint32_t IndirectScene::instanceCount() const { return m_instanceCount; }
+
+uint32_t IndirectScene::drawCount() const { return m_drawCount; }
+
+uint32_t IndirectScene::outputCount() const {
+  return static_cast<uint32_t>(m_outputs.size());
+}
+
+VkBuffer IndirectScene::instanceBuffer() const {
+  return m_instanceBuffer.buffer;
+}
+
+VkBuffer IndirectScene::indirectBuffer(uint32_t output) const {
+  return m_outputs[output].indirectBuffer.buffer;
+}
+
+VkBuffer IndirectScene::visibleBuffer(uint32_t output) const {
+  return m_outputs[output].visibleBuffer.buffer;
+}
+
+VkBuffer IndirectScene::resetBuffer() const { return m_resetBuffer.buffer; }
+
+void IndirectScene::record(VkCommandBuffer commandBuffer,
+                           VkPipelineLayout pipelineLayout,
+                           View const &view, uint32_t output) const {
+  Output const &o = m_outputs[output];
+  VkDeviceSize const offset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer.buffer, &offset);
+  vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.buffer, 0,
+                       VK_INDEX_TYPE_UINT16);
+  if (m_heap) {
+    BindlessView const constants{view, m_instanceHandle, o.visibleHandle};
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+                       &constants);
+  } else {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 0, 1, &o.descriptorSet, 0,
+                            nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(View), &view);
+  }
+
+  uint32_t const stride = sizeof(VkDrawIndexedIndirectCommand);
+  if (m_drawIndirectCount) {
+    m_drawIndirectCount(commandBuffer, o.indirectBuffer.buffer, 0,
+                        m_countBuffer.buffer, 0, m_drawCount, stride);
+  } else if (m_multiDrawIndirect) {
+    vkCmdDrawIndexedIndirect(commandBuffer, o.indirectBuffer.buffer, 0,
+                             m_drawCount, stride);
+  } else {
+    for (uint32_t i = 0; i < m_drawCount; i++) {
+      vkCmdDrawIndexedIndirect(commandBuffer, o.indirectBuffer.buffer,
+                               i * stride, 1, stride);
+    }
+  }
+}
+
+IndirectScene::Buffer
+IndirectScene::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                            std::vector<uint32_t> const &families) {
+  VkBufferCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  info.size = size;
+  info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  if (families.size() > 1) {
+    info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    info.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+    info.pQueueFamilyIndices = families.data();
+  } else {
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  }
+
+  Buffer buffer;
+  if (vkCreateBuffer(m_device, &info, nullptr, &buffer.buffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create scene buffer");
+  }
+  buffer.allocation = m_allocator.allocateForBuffer(
+      buffer.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  return buffer;
+}
+
+void IndirectScene::destroyBuffer(Buffer &buffer) {
+  vkDestroyBuffer(m_device, buffer.buffer, nullptr);
+  m_allocator.free(buffer.allocation);
+  buffer = {};
+}
+
+void IndirectScene::createDescriptorSets() {
+  // Instances and the indices of the visible ones
+  VkDescriptorSetLayoutBinding bindings[2] = {};
+  for (uint32_t i = 0; i < 2; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = 2;
+  layoutInfo.pBindings = bindings;
+
+  m_descriptorSetLayout = m_objects.acquire(layoutInfo);
+
+  uint32_t const setCount = outputCount();
+
+  VkDescriptorPoolSize poolSize{};
+  poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSize.descriptorCount = 2 * setCount;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = setCount;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+
+  if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor pool");
+  }
+
+  std::vector<VkDescriptorSetLayout> const setLayouts(setCount,
+                                                      m_descriptorSetLayout);
+  std::vector<VkDescriptorSet> sets(setCount);
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = m_descriptorPool;
+  allocInfo.descriptorSetCount = setCount;
+  allocInfo.pSetLayouts = setLayouts.data();
+
+  if (vkAllocateDescriptorSets(m_device, &allocInfo, sets.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate descriptor set");
+  }
+
+  for (uint32_t i = 0; i < setCount; i++) {
+    Output &output = m_outputs[i];
+    output.descriptorSet = sets[i];
+
+    VkDescriptorBufferInfo bufferInfos[2] = {
+        {m_instanceBuffer.buffer, 0, VK_WHOLE_SIZE},
+        {output.visibleBuffer.buffer, 0, VK_WHOLE_SIZE},
+    };
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = output.descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 2;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = bufferInfos;
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+  }
+}
@@ -6,6 +6,11 @@ MainWindow::MainWindow(int width, int height, const std::string &title) {
   GLFWwindow *window =
       glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
   m_window = std::unique_ptr<GLFWwindow, WindowDeleter>(window);
+
+  if (m_window) {
+    glfwSetWindowUserPointer(window, this);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+  }
 }
 
 MainWindow::~MainWindow() {}
@@ -38,6 +43,19 @@ bool MainWindow::shouldClose() const {
 
 void MainWindow::swapBuffers() { glfwSwapBuffers(m_window.get()); }
 
+bool MainWindow::takeFramebufferResized() {
+  bool const resized = m_framebufferResized;
+  m_framebufferResized = false;
+  return resized;
+}
+
+void MainWindow::framebufferSizeCallback(GLFWwindow *window, int width,
+                                         int height) {
+  auto *mainWindow =
+      static_cast<MainWindow *>(glfwGetWindowUserPointer(window));
+  mainWindow->m_framebufferResized = true;
+}
+
 VkSurfaceKHR MainWindow::createSurface(VkInstance instance) const {
   VkSurfaceKHR surface;
   if (glfwCreateWindowSurface(instance, m_window.get(), nullptr, &surface) !=
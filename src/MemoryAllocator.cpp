@@ -0,0 +1,310 @@
+#include "MemoryAllocator.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+
+VkDeviceSize nextPowerOfTwo(VkDeviceSize value) {
+  VkDeviceSize result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+} // namespace
+
+double MemoryAllocator::Statistics::internalFragmentation() const {
+  if (allocatedBytes == 0)
+    return 0.0;
+  return 1.0 - static_cast<double>(requestedBytes) / allocatedBytes;
+}
+
+double MemoryAllocator::Statistics::externalFragmentation() const {
+  if (freeBytes == 0)
+    return 0.0;
+  return 1.0 - static_cast<double>(contiguousFreeBytes) / freeBytes;
+}
+
+MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice,
+                                 VkDevice device, VkDeviceSize blockSize)
+    : m_device(device) {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+  // Buddy blocks split in halves, so the block has to be a power of two
+  m_blockSize = nextPowerOfTwo(std::max(blockSize, m_minAllocationSize));
+  m_orderCount = 1;
+  while (orderSize(m_orderCount - 1) < m_blockSize) {
+    m_orderCount++;
+  }
+}
+
+MemoryAllocator::~MemoryAllocator() {
+  for (Pool const &pool : m_pools) {
+    for (auto const &block : pool.blocks) {
+      vkFreeMemory(m_device, block->memory, nullptr);
+    }
+  }
+}
+
+MemoryAllocator::Allocation
+MemoryAllocator::allocate(VkMemoryRequirements const &requirements,
+                          VkMemoryPropertyFlags properties, bool linear) {
+  uint32_t const memoryType =
+      findMemoryType(requirements.memoryTypeBits, properties);
+
+  // Buddy ranges are aligned to their own size, which covers the alignment
+  VkDeviceSize const size = nextPowerOfTwo(std::max(
+      {requirements.size, requirements.alignment, m_minAllocationSize}));
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Allocation allocation{};
+  allocation.size = requirements.size;
+
+  if (size > m_blockSize) {
+    allocation.memory =
+        allocateMemory(memoryType, requirements.size, &allocation.mapped);
+    allocation.dedicated = true;
+    m_dedicatedCount++;
+    m_dedicatedBytes += requirements.size;
+    m_allocationCount++;
+    m_requestedBytes += requirements.size;
+    m_allocatedBytes += requirements.size;
+    return allocation;
+  }
+
+  uint32_t order = 0;
+  while (orderSize(order) < size) {
+    order++;
+  }
+
+  allocation.pool = poolIndex(memoryType, linear);
+  Pool &pool = m_pools[allocation.pool];
+
+  // Smallest free range that fits, in any block
+  Block *block = nullptr;
+  uint32_t foundOrder = m_orderCount;
+  for (size_t i = 0; i < pool.blocks.size() && foundOrder != order; i++) {
+    for (uint32_t o = order; o < foundOrder; o++) {
+      if (!pool.blocks[i]->freeLists[o].empty()) {
+        block = pool.blocks[i].get();
+        allocation.block = static_cast<uint32_t>(i);
+        foundOrder = o;
+        break;
+      }
+    }
+  }
+
+  if (!block) {
+    block = &createBlock(pool);
+    allocation.block = static_cast<uint32_t>(pool.blocks.size() - 1);
+    foundOrder = m_orderCount - 1;
+  }
+
+  auto first = block->freeLists[foundOrder].begin();
+  VkDeviceSize const offset = *first;
+  block->freeLists[foundOrder].erase(first);
+
+  // Split down to the requested order, freeing the upper halves
+  for (uint32_t o = foundOrder; o > order; o--) {
+    block->freeLists[o - 1].insert(offset + orderSize(o - 1));
+  }
+
+  block->allocationCount++;
+
+  allocation.memory = block->memory;
+  allocation.offset = offset;
+  allocation.order = order;
+  if (block->mapped) {
+    allocation.mapped = static_cast<char *>(block->mapped) + offset;
+  }
+
+  m_allocationCount++;
+  m_requestedBytes += requirements.size;
+  m_allocatedBytes += orderSize(order);
+  return allocation;
+}
+
+void MemoryAllocator::free(Allocation const &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_allocationCount--;
+  m_requestedBytes -= allocation.size;
+
+  if (allocation.dedicated) {
+    vkFreeMemory(m_device, allocation.memory, nullptr);
+    m_dedicatedCount--;
+    m_dedicatedBytes -= allocation.size;
+    m_allocatedBytes -= allocation.size;
+    return;
+  }
+
+  m_allocatedBytes -= orderSize(allocation.order);
+
+  Block &block = *m_pools[allocation.pool].blocks[allocation.block];
+  block.allocationCount--;
+
+  // Merge with the buddy for as long as it is free too
+  VkDeviceSize offset = allocation.offset;
+  uint32_t order = allocation.order;
+  while (order + 1 < m_orderCount) {
+    VkDeviceSize const buddy = offset ^ orderSize(order);
+    auto it = block.freeLists[order].find(buddy);
+    if (it == block.freeLists[order].end())
+      break;
+    block.freeLists[order].erase(it);
+    offset = std::min(offset, buddy);
+    order++;
+  }
+  block.freeLists[order].insert(offset);
+}
+
+MemoryAllocator::Allocation
+MemoryAllocator::allocateForBuffer(VkBuffer buffer,
+                                   VkMemoryPropertyFlags properties) {
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(m_device, buffer, &requirements);
+
+  Allocation allocation = allocate(requirements, properties, true);
+  if (vkBindBufferMemory(m_device, buffer, allocation.memory,
+                         allocation.offset) != VK_SUCCESS) {
+    free(allocation);
+    throw std::runtime_error("Failed to bind buffer memory");
+  }
+  return allocation;
+}
+
+MemoryAllocator::Allocation
+MemoryAllocator::allocateForImage(VkImage image,
+                                  VkMemoryPropertyFlags properties,
+                                  bool linearTiling) {
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(m_device, image, &requirements);
+
+  Allocation allocation = allocate(requirements, properties, linearTiling);
+  if (vkBindImageMemory(m_device, image, allocation.memory,
+                        allocation.offset) != VK_SUCCESS) {
+    free(allocation);
+    throw std::runtime_error("Failed to bind image memory");
+  }
+  return allocation;
+}
+
+uint32_t
+MemoryAllocator::findMemoryType(uint32_t typeFilter,
+                                VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (m_memoryProperties.memoryTypes[i].propertyFlags & properties) ==
+            properties)
+      return i;
+  }
+
+  throw std::runtime_error("Failed to find suitable memory type");
+}
+
+MemoryAllocator::Statistics MemoryAllocator::statistics() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Statistics statistics{};
+  statistics.dedicatedCount = m_dedicatedCount;
+  statistics.allocationCount = m_allocationCount;
+  statistics.reservedBytes = m_dedicatedBytes;
+  statistics.requestedBytes = m_requestedBytes;
+  statistics.allocatedBytes = m_allocatedBytes;
+
+  for (Pool const &pool : m_pools) {
+    for (auto const &block : pool.blocks) {
+      statistics.blockCount++;
+      statistics.reservedBytes += m_blockSize;
+
+      VkDeviceSize largest = 0;
+      for (uint32_t order = 0; order < m_orderCount; order++) {
+        size_t const count = block->freeLists[order].size();
+        statistics.freeBytes += count * orderSize(order);
+        if (count > 0) {
+          largest = orderSize(order);
+        }
+      }
+      statistics.largestFreeRange =
+          std::max(statistics.largestFreeRange, largest);
+      statistics.contiguousFreeBytes += largest;
+    }
+  }
+
+  return statistics;
+}
+
+void MemoryAllocator::writeStatistics(std::ostream &stream) const {
+  Statistics const s = statistics();
+  double const mebibyte = 1024.0 * 1024.0;
+
+  stream << "Device memory:\n"
+         << std::fixed << std::setprecision(2) << "\tblocks " << s.blockCount
+         << ", dedicated " << s.dedicatedCount << ", allocations "
+         << s.allocationCount << '\n'
+         << "\treserved " << s.reservedBytes / mebibyte << " MiB, requested "
+         << s.requestedBytes / mebibyte << " MiB, free "
+         << s.freeBytes / mebibyte << " MiB\n"
+         << "\tfragmentation internal " << s.internalFragmentation() * 100.0
+         << "%, external " << s.externalFragmentation() * 100.0 << "%\n";
+  stream << std::defaultfloat;
+}
+
+uint32_t MemoryAllocator::poolIndex(uint32_t memoryType, bool linear) {
+  for (size_t i = 0; i < m_pools.size(); i++) {
+    if (m_pools[i].memoryType == memoryType && m_pools[i].linear == linear)
+      return static_cast<uint32_t>(i);
+  }
+
+  m_pools.push_back({memoryType, linear, {}});
+  return static_cast<uint32_t>(m_pools.size() - 1);
+}
+
+MemoryAllocator::Block &MemoryAllocator::createBlock(Pool &pool) {
+  auto block = std::make_unique<Block>();
+  block->memory = allocateMemory(pool.memoryType, m_blockSize, &block->mapped);
+  block->freeLists.resize(m_orderCount);
+  block->freeLists[m_orderCount - 1].insert(0);
+
+  pool.blocks.push_back(std::move(block));
+  return *pool.blocks.back();
+}
+
+VkDeviceMemory MemoryAllocator::allocateMemory(uint32_t memoryType,
+                                               VkDeviceSize size,
+                                               void **mapped) const {
+  VkMemoryAllocateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  info.allocationSize = size;
+  info.memoryTypeIndex = memoryType;
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(m_device, &info, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate device memory");
+  }
+
+  *mapped = nullptr;
+  if (isHostVisible(memoryType) &&
+      vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped) !=
+          VK_SUCCESS) {
+    vkFreeMemory(m_device, memory, nullptr);
+    throw std::runtime_error("Failed to map device memory");
+  }
+  return memory;
+}
+
+bool MemoryAllocator::isHostVisible(uint32_t memoryType) const {
+  return (m_memoryProperties.memoryTypes[memoryType].propertyFlags &
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+VkDeviceSize MemoryAllocator::orderSize(uint32_t order) const {
+  return m_minAllocationSize << order;
+}
@@ -0,0 +1,729 @@
+#include "ObjectCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+using Type = ObjectCache::Type;
+
+template <typename Handle> uint64_t handleValue(Handle handle) {
+  if constexpr (std::is_pointer_v<Handle>)
+    return reinterpret_cast<uintptr_t>(handle);
+  else
+    return static_cast<uint64_t>(handle);
+}
+
+template <typename Handle> Handle fromValue(uint64_t value) {
+  if constexpr (std::is_pointer_v<Handle>)
+    return reinterpret_cast<Handle>(static_cast<uintptr_t>(value));
+  else
+    return static_cast<Handle>(value);
+}
+
+void requireNoChain(void const *next) {
+  if (next != nullptr) {
+    throw std::runtime_error(
+        "Failed to cache object: pNext chains are not supported");
+  }
+}
+
+// Serializes a create info one field at a time into a key, collecting the
+// handles it refers to along the way
+class KeyWriter {
+public:
+  explicit KeyWriter(Type type) { add(static_cast<uint32_t>(type)); }
+
+  template <typename T> void add(T value) {
+    static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+    key.append(reinterpret_cast<char const *>(&value), sizeof(value));
+  }
+
+  template <typename Handle> void addHandle(Type type, Handle handle) {
+    uint64_t const value = handleValue(handle);
+    add(value);
+    if (value != 0)
+      dependencies.push_back({type, value});
+  }
+
+  void addBytes(void const *data, size_t size) {
+    add(static_cast<uint64_t>(size));
+    key.append(static_cast<char const *>(data), size);
+  }
+
+  void addString(char const *string) {
+    addBytes(string, std::strlen(string));
+  }
+
+  // Optional structs are preceded by whether they are there
+  bool addPresent(void const *pointer) {
+    add(static_cast<uint8_t>(pointer != nullptr));
+    return pointer != nullptr;
+  }
+
+  std::string key;
+  std::vector<std::pair<Type, uint64_t>> dependencies;
+};
+
+void describe(KeyWriter &w, VkShaderModuleCreateInfo const &info) {
+  requireNoChain(info.pNext);
+  w.add(info.flags);
+  w.addBytes(info.pCode, info.codeSize);
+}
+
+void describe(KeyWriter &w, VkDescriptorSetLayoutCreateInfo const &info) {
+  requireNoChain(info.pNext);
+  w.add(info.flags);
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings(
+      info.pBindings, info.pBindings + info.bindingCount);
+  std::sort(bindings.begin(), bindings.end(),
+            [](VkDescriptorSetLayoutBinding const &a,
+               VkDescriptorSetLayoutBinding const &b) {
+              return a.binding < b.binding;
+            });
+
+  w.add(info.bindingCount);
+  for (VkDescriptorSetLayoutBinding const &binding : bindings) {
+    w.add(binding.binding);
+    w.add(binding.descriptorType);
+    w.add(binding.descriptorCount);
+    w.add(binding.stageFlags);
+
+    // Only read for sampler descriptors
+    bool const samplers =
+        binding.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+        binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    if (w.addPresent(samplers ? binding.pImmutableSamplers : nullptr)) {
+      for (uint32_t i = 0; i < binding.descriptorCount; i++) {
+        w.addHandle(Type::Sampler, binding.pImmutableSamplers[i]);
+      }
+    }
+  }
+}
+
+void describe(KeyWriter &w, VkPipelineLayoutCreateInfo const &info) {
+  requireNoChain(info.pNext);
+  w.add(info.flags);
+  w.add(info.setLayoutCount);
+  for (uint32_t i = 0; i < info.setLayoutCount; i++) {
+    w.addHandle(Type::DescriptorSetLayout, info.pSetLayouts[i]);
+  }
+  w.add(info.pushConstantRangeCount);
+  for (uint32_t i = 0; i < info.pushConstantRangeCount; i++) {
+    VkPushConstantRange const &range = info.pPushConstantRanges[i];
+    w.add(range.stageFlags);
+    w.add(range.offset);
+    w.add(range.size);
+  }
+}
+
+void describe(KeyWriter &w, VkAttachmentReference const *reference) {
+  if (w.addPresent(reference)) {
+    w.add(reference->attachment);
+    w.add(reference->layout);
+  }
+}
+
+void describe(KeyWriter &w, VkRenderPassCreateInfo const &info) {
+  requireNoChain(info.pNext);
+  w.add(info.flags);
+
+  w.add(info.attachmentCount);
+  for (uint32_t i = 0; i < info.attachmentCount; i++) {
+    VkAttachmentDescription const &attachment = info.pAttachments[i];
+    w.add(attachment.flags);
+    w.add(attachment.format);
+    w.add(attachment.samples);
+    w.add(attachment.loadOp);
+    w.add(attachment.storeOp);
+    w.add(attachment.stencilLoadOp);
+    w.add(attachment.stencilStoreOp);
+    w.add(attachment.initialLayout);
+    w.add(attachment.finalLayout);
+  }
+
+  w.add(info.subpassCount);
+  for (uint32_t i = 0; i < info.subpassCount; i++) {
+    VkSubpassDescription const &subpass = info.pSubpasses[i];
+    w.add(subpass.flags);
+    w.add(subpass.pipelineBindPoint);
+    w.add(subpass.inputAttachmentCount);
+    for (uint32_t j = 0; j < subpass.inputAttachmentCount; j++) {
+      describe(w, &subpass.pInputAttachments[j]);
+    }
+    w.add(subpass.colorAttachmentCount);
+    for (uint32_t j = 0; j < subpass.colorAttachmentCount; j++) {
+      describe(w, &subpass.pColorAttachments[j]);
+    }
+    if (w.addPresent(subpass.pResolveAttachments)) {
+      for (uint32_t j = 0; j < subpass.colorAttachmentCount; j++) {
+        describe(w, &subpass.pResolveAttachments[j]);
+      }
+    }
+    describe(w, subpass.pDepthStencilAttachment);
+    w.add(subpass.preserveAttachmentCount);
+    for (uint32_t j = 0; j < subpass.preserveAttachmentCount; j++) {
+      w.add(subpass.pPreserveAttachments[j]);
+    }
+  }
+
+  w.add(info.dependencyCount);
+  for (uint32_t i = 0; i < info.dependencyCount; i++) {
+    VkSubpassDependency const &dependency = info.pDependencies[i];
+    w.add(dependency.srcSubpass);
+    w.add(dependency.dstSubpass);
+    w.add(dependency.srcStageMask);
+    w.add(dependency.dstStageMask);
+    w.add(dependency.srcAccessMask);
+    w.add(dependency.dstAccessMask);
+    w.add(dependency.dependencyFlags);
+  }
+}
+
+void describe(KeyWriter &w, VkSamplerCreateInfo const &info) {
+  requireNoChain(info.pNext);
+  w.add(info.flags);
+  w.add(info.magFilter);
+  w.add(info.minFilter);
+  w.add(info.mipmapMode);
+  w.add(info.addressModeU);
+  w.add(info.addressModeV);
+  w.add(info.addressModeW);
+  w.add(info.mipLodBias);
+  w.add(info.anisotropyEnable);
+  w.add(info.maxAnisotropy);
+  w.add(info.compareEnable);
+  w.add(info.compareOp);
+  w.add(info.minLod);
+  w.add(info.maxLod);
+  w.add(info.borderColor);
+  w.add(info.unnormalizedCoordinates);
+}
+
+void describe(KeyWriter &w, VkPipelineShaderStageCreateInfo const &stage) {
+  requireNoChain(stage.pNext);
+  w.add(stage.flags);
+  w.add(stage.stage);
+  w.addHandle(Type::ShaderModule, stage.module);
+  w.addString(stage.pName);
+
+  VkSpecializationInfo const *specialization = stage.pSpecializationInfo;
+  if (w.addPresent(specialization)) {
+    w.add(specialization->mapEntryCount);
+    for (uint32_t i = 0; i < specialization->mapEntryCount; i++) {
+      VkSpecializationMapEntry const &entry = specialization->pMapEntries[i];
+      w.add(entry.constantID);
+      w.add(entry.offset);
+      w.add(static_cast<uint64_t>(entry.size));
+    }
+    w.addBytes(specialization->pData, specialization->dataSize);
+  }
+}
+
+void describe(KeyWriter &w, VkStencilOpState const &state) {
+  w.add(state.failOp);
+  w.add(state.passOp);
+  w.add(state.depthFailOp);
+  w.add(state.compareOp);
+  w.add(state.compareMask);
+  w.add(state.writeMask);
+  w.add(state.reference);
+}
+
+// Takes the place of a render pass with dynamic rendering
+void describe(KeyWriter &w, VkPipelineRenderingCreateInfoKHR const &info) {
+  if (info.sType != VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR) {
+    throw std::runtime_error(
+        "Failed to cache object: pNext chains are not supported");
+  }
+  requireNoChain(info.pNext);
+  w.add(info.viewMask);
+  w.add(info.colorAttachmentCount);
+  for (uint32_t i = 0; i < info.colorAttachmentCount; i++) {
+    w.add(info.pColorAttachmentFormats[i]);
+  }
+  w.add(info.depthAttachmentFormat);
+  w.add(info.stencilAttachmentFormat);
+}
+
+void describe(KeyWriter &w, VkGraphicsPipelineCreateInfo const &info) {
+  auto const *rendering =
+      static_cast<VkPipelineRenderingCreateInfoKHR const *>(info.pNext);
+  if (w.addPresent(rendering))
+    describe(w, *rendering);
+  w.add(info.flags);
+
+  w.add(info.stageCount);
+  for (uint32_t i = 0; i < info.stageCount; i++) {
+    describe(w, info.pStages[i]);
+  }
+
+  if (auto const *state = info.pVertexInputState; w.addPresent(state)) {
+    requireNoChain(state->pNext);
+    w.add(state->vertexBindingDescriptionCount);
+    for (uint32_t i = 0; i < state->vertexBindingDescriptionCount; i++) {
+      VkVertexInputBindingDescription const &binding =
+          state->pVertexBindingDescriptions[i];
+      w.add(binding.binding);
+      w.add(binding.stride);
+      w.add(binding.inputRate);
+    }
+    w.add(state->vertexAttributeDescriptionCount);
+    for (uint32_t i = 0; i < state->vertexAttributeDescriptionCount; i++) {
+      VkVertexInputAttributeDescription const &attribute =
+          state->pVertexAttributeDescriptions[i];
+      w.add(attribute.location);
+      w.add(attribute.binding);
+      w.add(attribute.format);
+      w.add(attribute.offset);
+    }
+  }
+
+  if (auto const *state = info.pInputAssemblyState; w.addPresent(state)) {
+    requireNoChain(state->pNext);
+    w.add(state->topology);
+    w.add(state->primitiveRestartEnable);
+  }
+
+  if (auto const *state = info.pTessellationState; w.addPresent(state)) {
+    requireNoChain(state->pNext);
+    w.add(state->patchControlPoints);
+  }
+
+  if (auto const *state = info.pViewportState; w.addPresent(state)) {
+    requireNoChain(state->pNext);
+    w.add(state->viewportCount);
+    if (w.addPresent(state->pViewports)) {
+      for (uint32_t i = 0; i < state->viewportCount; i++) {
+        VkViewport const &viewport = state->pViewports[i];
+        w.add(viewport.x);
+        w.add(viewport.y);
+        w.add(viewport.width);
+        w.add(viewport.height);
+        w.add(viewport.minDepth);
+        w.add(viewport.maxDepth);
+      }
+    }
+    w.add(state->scissorCount);
+    if (w.addPresent(state->pScissors)) {
+      for (uint32_t i = 0; i < state->scissorCount; i++) {
+        VkRect2D const &scissor = state->pScissors[i];
+        w.add(scissor.offset.x);
+        w.add(scissor.offset.y);
+        w.add(scissor.extent.width);
+        w.add(scissor.extent.height);
+      }
+    }
+  }
+
+  if (auto const *state = info.pRasterizationState; w.addPresent(state)) {
+    requireNoChain(state->pNext);
+    w.add(state->depthClampEnable);
+    w.add(state->rasterizerDiscardEnable);
+    w.add(state->polygonMode);
+    w.add(state->cullMode);
+    w.add(state->frontFace);
+    w.add(state->depthBiasEnable);
+    w.add(state->depthBiasConstantFactor);
+    w.add(state->depthBiasClamp);
+    w.add(state->depthBiasSlopeFactor);
+    w.add(state->lineWidth);
+  }
+
+  if (auto const *state = info.pMultisampleState; w.addPresent(state)) {
+    requireNoChain(state->pNext);
+    w.add(state->rasterizationSamples);
+    w.add(state->sampleShadingEnable);
+    w.add(state->minSampleShading);
+    if (w.addPresent(state->pSampleMask)) {
+      uint32_t const words = (state->rasterizationSamples + 31) / 32;
+      for (uint32_t i = 0; i < words; i++) {
+        w.add(state->pSampleMask[i]);
+      }
+    }
+    w.add(state->alphaToCoverageEnable);
+    w.add(state->alphaToOneEnable);
+  }
+
+  if (auto const *state = info.pDepthStencilState; w.addPresent(state)) {
+    requireNoChain(state->pNext);
+    w.add(state->flags);
+    w.add(state->depthTestEnable);
+    w.add(state->depthWriteEnable);
+    w.add(state->depthCompareOp);
+    w.add(state->depthBoundsTestEnable);
+    w.add(state->stencilTestEnable);
+    describe(w, state->front);
+    describe(w, state->back);
+    w.add(state->minDepthBounds);
+    w.add(state->maxDepthBounds);
+  }
+
+  if (auto const *state = info.pColorBlendState; w.addPresent(state)) {
+    requireNoChain(state->pNext);
+    w.add(state->flags);
+    w.add(state->logicOpEnable);
+    w.add(state->logicOp);
+    w.add(state->attachmentCount);
+    for (uint32_t i = 0; i < state->attachmentCount; i++) {
+      VkPipelineColorBlendAttachmentState const &attachment =
+          state->pAttachments[i];
+      w.add(attachment.blendEnable);
+      w.add(attachment.srcColorBlendFactor);
+      w.add(attachment.dstColorBlendFactor);
+      w.add(attachment.colorBlendOp);
+      w.add(attachment.srcAlphaBlendFactor);
+      w.add(attachment.dstAlphaBlendFactor);
+      w.add(attachment.alphaBlendOp);
+      w.add(attachment.colorWriteMask);
+    }
+    for (float constant : state->blendConstants) {
+      w.add(constant);
+    }
+  }
+
+  if (auto const *state = info.pDynamicState; w.addPresent(state)) {
+    requireNoChain(state->pNext);
+    w.add(state->dynamicStateCount);
+    for (uint32_t i = 0; i < state->dynamicStateCount; i++) {
+      w.add(state->pDynamicStates[i]);
+    }
+  }
+
+  w.addHandle(Type::PipelineLayout, info.layout);
+  w.addHandle(Type::RenderPass, info.renderPass);
+  w.add(info.subpass);
+}
+
+void describe(KeyWriter &w, VkComputePipelineCreateInfo const &info) {
+  requireNoChain(info.pNext);
+  w.add(info.flags);
+  describe(w, info.stage);
+  w.addHandle(Type::PipelineLayout, info.layout);
+}
+
+char const *typeName(Type type) {
+  switch (type) {
+  case Type::ShaderModule:
+    return "shader modules";
+  case Type::DescriptorSetLayout:
+    return "descriptor set layouts";
+  case Type::PipelineLayout:
+    return "pipeline layouts";
+  case Type::RenderPass:
+    return "render passes";
+  case Type::Sampler:
+    return "samplers";
+  case Type::Pipeline:
+    return "pipelines";
+  }
+  return "objects";
+}
+
+} // namespace
+
+ObjectCache::Statistics::Counts ObjectCache::Statistics::total() const {
+  Counts total;
+  for (Counts const &counts : types) {
+    total.requests += counts.requests;
+    total.hits += counts.hits;
+    total.live += counts.live;
+  }
+  return total;
+}
+
+size_t ObjectCache::EntryKeyHash::operator()(EntryKey const &key) const {
+  return std::hash<uint64_t>()(key.second) ^
+         static_cast<size_t>(key.first) << 1;
+}
+
+ObjectCache::ObjectCache(VkDevice device) : m_device(device) {}
+
+ObjectCache::~ObjectCache() {
+  // Dependents before what they depend on
+  for (Type type : {Type::Pipeline, Type::PipelineLayout, Type::RenderPass,
+                    Type::DescriptorSetLayout, Type::Sampler,
+                    Type::ShaderModule}) {
+    for (auto const &[entryKey, entry] : m_entries) {
+      if (entryKey.first == type)
+        destroy(type, entryKey.second);
+    }
+  }
+}
+
+template <typename Handle, typename Info, typename Create>
+Handle ObjectCache::acquireObject(Type type, Info const &info,
+                                  Create const &create) {
+  KeyWriter writer(type);
+  describe(writer, info);
+  if (uint64_t const handle = find(type, writer.key))
+    return fromValue<Handle>(handle);
+
+  Handle handle;
+  if (create(&info, &handle) != VK_SUCCESS) {
+    throw std::runtime_error(std::string("Failed to create ") +
+                             typeName(type));
+  }
+  return fromValue<Handle>(insert(type, std::move(writer.key),
+                                  writer.dependencies, handleValue(handle)));
+}
+
+VkShaderModule ObjectCache::acquire(VkShaderModuleCreateInfo const &info) {
+  return acquireObject<VkShaderModule>(
+      Type::ShaderModule, info, [this](auto info, auto handle) {
+        return vkCreateShaderModule(m_device, info, nullptr, handle);
+      });
+}
+
+VkDescriptorSetLayout
+ObjectCache::acquire(VkDescriptorSetLayoutCreateInfo const &info) {
+  return acquireObject<VkDescriptorSetLayout>(
+      Type::DescriptorSetLayout, info, [this](auto info, auto handle) {
+        return vkCreateDescriptorSetLayout(m_device, info, nullptr, handle);
+      });
+}
+
+VkPipelineLayout ObjectCache::acquire(VkPipelineLayoutCreateInfo const &info) {
+  return acquireObject<VkPipelineLayout>(
+      Type::PipelineLayout, info, [this](auto info, auto handle) {
+        return vkCreatePipelineLayout(m_device, info, nullptr, handle);
+      });
+}
+
+VkRenderPass ObjectCache::acquire(VkRenderPassCreateInfo const &info) {
+  return acquireObject<VkRenderPass>(
+      Type::RenderPass, info, [this](auto info, auto handle) {
+        return vkCreateRenderPass(m_device, info, nullptr, handle);
+      });
+}
+
+VkSampler ObjectCache::acquire(VkSamplerCreateInfo const &info) {
+  return acquireObject<VkSampler>(
+      Type::Sampler, info, [this](auto info, auto handle) {
+        return vkCreateSampler(m_device, info, nullptr, handle);
+      });
+}
+
+template <typename Info, typename Create>
+std::vector<VkPipeline> ObjectCache::acquirePipelines(Info const *infos,
+                                                      uint32_t count,
+                                                      Create const &create) {
+  std::vector<VkPipeline> pipelines(count, VK_NULL_HANDLE);
+  std::vector<KeyWriter> missingWriters;
+  std::vector<Info> missingInfos;
+  std::vector<uint32_t> missingIndices;
+
+  for (uint32_t i = 0; i < count; i++) {
+    KeyWriter writer(Type::Pipeline);
+    describe(writer, infos[i]);
+    if (uint64_t const handle = find(Type::Pipeline, writer.key)) {
+      pipelines[i] = fromValue<VkPipeline>(handle);
+    } else {
+      missingWriters.push_back(std::move(writer));
+      missingInfos.push_back(infos[i]);
+      missingIndices.push_back(i);
+    }
+  }
+  if (missingInfos.empty())
+    return pipelines;
+
+  std::vector<VkPipeline> created(missingInfos.size(), VK_NULL_HANDLE);
+  if (create(static_cast<uint32_t>(missingInfos.size()), missingInfos.data(),
+             created.data()) != VK_SUCCESS) {
+    // Some may have been created regardless
+    for (VkPipeline pipeline : created) {
+      vkDestroyPipeline(m_device, pipeline, nullptr);
+    }
+    for (VkPipeline pipeline : pipelines) {
+      release(pipeline);
+    }
+    throw std::runtime_error("Failed to create pipelines");
+  }
+
+  for (size_t i = 0; i < created.size(); i++) {
+    pipelines[missingIndices[i]] = fromValue<VkPipeline>(
+        insert(Type::Pipeline, std::move(missingWriters[i].key),
+               missingWriters[i].dependencies, handleValue(created[i])));
+  }
+  return pipelines;
+}
+
+std::vector<VkPipeline>
+ObjectCache::acquire(VkGraphicsPipelineCreateInfo const *infos, uint32_t count,
+                     VkPipelineCache pipelineCache) {
+  return acquirePipelines(
+      infos, count,
+      [this, pipelineCache](uint32_t createCount, auto infos, auto pipelines) {
+        return vkCreateGraphicsPipelines(m_device, pipelineCache, createCount,
+                                         infos, nullptr, pipelines);
+      });
+}
+
+std::vector<VkPipeline>
+ObjectCache::acquire(VkComputePipelineCreateInfo const *infos, uint32_t count,
+                     VkPipelineCache pipelineCache) {
+  return acquirePipelines(
+      infos, count,
+      [this, pipelineCache](uint32_t createCount, auto infos, auto pipelines) {
+        return vkCreateComputePipelines(m_device, pipelineCache, createCount,
+                                        infos, nullptr, pipelines);
+      });
+}
+
+void ObjectCache::release(VkShaderModule shaderModule) {
+  releaseHandle(Type::ShaderModule, handleValue(shaderModule));
+}
+
+void ObjectCache::release(VkDescriptorSetLayout setLayout) {
+  releaseHandle(Type::DescriptorSetLayout, handleValue(setLayout));
+}
+
+void ObjectCache::release(VkPipelineLayout pipelineLayout) {
+  releaseHandle(Type::PipelineLayout, handleValue(pipelineLayout));
+}
+
+void ObjectCache::release(VkRenderPass renderPass) {
+  releaseHandle(Type::RenderPass, handleValue(renderPass));
+}
+
+void ObjectCache::release(VkSampler sampler) {
+  releaseHandle(Type::Sampler, handleValue(sampler));
+}
+
+void ObjectCache::release(VkPipeline pipeline) {
+  releaseHandle(Type::Pipeline, handleValue(pipeline));
+}
+
+uint64_t ObjectCache::find(Type type, std::string const &key) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Statistics::Counts &counts =
+      m_statistics.types[static_cast<size_t>(type)];
+  counts.requests++;
+
+  auto const it = m_handles.find(key);
+  if (it == m_handles.end())
+    return 0;
+
+  counts.hits++;
+  m_entries.at({type, it->second}).references++;
+  return it->second;
+}
+
+uint64_t
+ObjectCache::insert(Type type, std::string key,
+                    std::vector<std::pair<Type, uint64_t>> const &dependencies,
+                    uint64_t handle) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Statistics::Counts &counts =
+      m_statistics.types[static_cast<size_t>(type)];
+
+  if (auto const it = m_handles.find(key); it != m_handles.end()) {
+    // Created twice by racing threads; keep the first one
+    destroy(type, handle);
+    counts.hits++;
+    m_entries.at({type, it->second}).references++;
+    return it->second;
+  }
+
+  Entry entry;
+  entry.key = key;
+  entry.references = 1;
+  for (std::pair<Type, uint64_t> const &dependency : dependencies) {
+    // Objects from elsewhere are the caller's to keep alive
+    auto const it = m_entries.find(dependency);
+    if (it == m_entries.end())
+      continue;
+    it->second.references++;
+    entry.dependencies.push_back(dependency);
+  }
+
+  m_handles.emplace(std::move(key), handle);
+  m_entries.emplace(EntryKey{type, handle}, std::move(entry));
+  counts.live++;
+  return handle;
+}
+
+void ObjectCache::releaseHandle(Type type, uint64_t handle) {
+  if (handle == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  releaseLocked(type, handle);
+}
+
+void ObjectCache::releaseLocked(Type type, uint64_t handle) {
+  auto const it = m_entries.find({type, handle});
+  if (it == m_entries.end()) {
+    throw std::runtime_error(std::string("Released one of the ") +
+                             typeName(type) + " not acquired from the cache");
+  }
+  if (--it->second.references > 0)
+    return;
+
+  std::vector<std::pair<Type, uint64_t>> const dependencies =
+      std::move(it->second.dependencies);
+  m_handles.erase(it->second.key);
+  m_entries.erase(it);
+  m_statistics.types[static_cast<size_t>(type)].live--;
+  destroy(type, handle);
+
+  for (std::pair<Type, uint64_t> const &dependency : dependencies) {
+    releaseLocked(dependency.first, dependency.second);
+  }
+}
+
+void ObjectCache::destroy(Type type, uint64_t handle) {
+  switch (type) {
+  case Type::ShaderModule:
+    vkDestroyShaderModule(m_device, fromValue<VkShaderModule>(handle),
+                          nullptr);
+    break;
+  case Type::DescriptorSetLayout:
+    vkDestroyDescriptorSetLayout(
+        m_device, fromValue<VkDescriptorSetLayout>(handle), nullptr);
+    break;
+  case Type::PipelineLayout:
+    vkDestroyPipelineLayout(m_device, fromValue<VkPipelineLayout>(handle),
+                            nullptr);
+    break;
+  case Type::RenderPass:
+    vkDestroyRenderPass(m_device, fromValue<VkRenderPass>(handle), nullptr);
+    break;
+  case Type::Sampler:
+    vkDestroySampler(m_device, fromValue<VkSampler>(handle), nullptr);
+    break;
+  case Type::Pipeline:
+    vkDestroyPipeline(m_device, fromValue<VkPipeline>(handle), nullptr);
+    break;
+  }
+}
+
+ObjectCache::Statistics ObjectCache::statistics() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_statistics;
+}
+
+void ObjectCache::writeStatistics(std::ostream &stream) const {
+  Statistics const s = statistics();
+
+  auto const writeCounts = [&stream](char const *name,
+                                     Statistics::Counts const &counts) {
+    double const hitRate =
+        counts.requests > 0 ? 100.0 * counts.hits / counts.requests : 0.0;
+    stream << '\t' << name << ": " << counts.requests << " requests, "
+           << counts.hits << " hits (" << hitRate << "%), " << counts.live
+           << " live\n";
+  };
+
+  stream << "Object cache:\n" << std::fixed << std::setprecision(2);
+  for (size_t i = 0; i < typeCount; i++) {
+    if (s.types[i].requests > 0)
+      writeCounts(typeName(static_cast<Type>(i)), s.types[i]);
+  }
+  writeCounts("total", s.total());
+  stream << std::defaultfloat;
+}
@@ -0,0 +1,117 @@
+#include "PipelineVariants.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+bool PipelineVariants::Key::operator==(Key const &other) const {
+  return constants == other.constants && polygonMode == other.polygonMode &&
+         cullMode == other.cullMode;
+}
+
+size_t PipelineVariants::KeyHash::operator()(Key const &key) const {
+  size_t hash = std::hash<uint32_t>()(key.polygonMode);
+  auto const combine = [&hash](uint32_t value) {
+    hash ^= std::hash<uint32_t>()(value) + 0x9e3779b9 + (hash << 6) +
+            (hash >> 2);
+  };
+  combine(key.cullMode);
+  for (uint32_t constant : key.constants) {
+    combine(constant);
+  }
+  return hash;
+}
+
+VkPipeline PipelineVariants::Handle::pipeline() const {
+  if (m_entry) {
+    VkPipeline const pipeline = m_entry->pipeline.load();
+    if (pipeline != VK_NULL_HANDLE)
+      return pipeline;
+  }
+  return m_fallback;
+}
+
+bool PipelineVariants::Handle::ready() const {
+  return !m_entry || m_entry->done.load();
+}
+
+PipelineVariants::PipelineVariants(ObjectCache &objects, ThreadPool &threads,
+                                   BuildFunction build, VkPipeline generic)
+    : m_objects(objects), m_threads(threads), m_build(std::move(build)),
+      m_generic(generic) {}
+
+PipelineVariants::~PipelineVariants() {
+  for (std::future<void> &batch : m_batches) {
+    batch.wait();
+  }
+  for (auto const &[key, entry] : m_entries) {
+    m_objects.release(entry->pipeline.load());
+  }
+}
+
+std::vector<PipelineVariants::Handle>
+PipelineVariants::request(std::vector<Key> const &keys) {
+  std::vector<Handle> handles(keys.size());
+  std::vector<Key> newKeys;
+  std::vector<std::shared_ptr<Entry>> newEntries;
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    handles[i].m_fallback = m_generic;
+    // Built from the default key, so there is nothing to specialize
+    if (keys[i] == Key{})
+      continue;
+
+    std::shared_ptr<Entry> &entry = m_entries[keys[i]];
+    if (!entry) {
+      entry = std::make_shared<Entry>();
+      newKeys.push_back(keys[i]);
+      newEntries.push_back(entry);
+    }
+    handles[i].m_entry = entry;
+  }
+
+  // Forget batches that are done, so the list doesn't grow with every request
+  auto const done = [](std::future<void> const &batch) {
+    return batch.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  };
+  m_batches.erase(std::remove_if(m_batches.begin(), m_batches.end(), done),
+                  m_batches.end());
+
+  size_t const batchCount = std::min(m_threads.size(), newKeys.size());
+  for (size_t batch = 0; batch < batchCount; batch++) {
+    size_t const begin = newKeys.size() * batch / batchCount;
+    size_t const end = newKeys.size() * (batch + 1) / batchCount;
+
+    std::vector<Key> batchKeys(newKeys.begin() + begin,
+                               newKeys.begin() + end);
+    std::vector<std::shared_ptr<Entry>> batchEntries(
+        newEntries.begin() + begin, newEntries.begin() + end);
+    m_batches.push_back(m_threads.submit(
+        [this, batchKeys = std::move(batchKeys),
+         batchEntries = std::move(batchEntries)]() mutable {
+          compile(std::move(batchKeys), std::move(batchEntries));
+        }));
+  }
+
+  return handles;
+}
+
+void PipelineVariants::compile(std::vector<Key> keys,
+                               std::vector<std::shared_ptr<Entry>> entries) {
+  std::vector<VkPipeline> pipelines;
+  try {
+    pipelines = m_build(keys);
+  } catch (std::exception const &e) {
+    // Handles keep drawing with the generic pipeline
+    std::cerr << "Failed to compile " << keys.size()
+              << " pipeline variants: " << e.what() << std::endl;
+  }
+
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (i < pipelines.size())
+      entries[i]->pipeline = pipelines[i];
+    entries[i]->done = true;
+  }
+  m_finished = true;
+}
@@ -0,0 +1,586 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t endStep = UINT32_MAX;
+
+constexpr VkAccessFlags writeAccessMask =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+    VK_ACCESS_MEMORY_WRITE_BIT;
+
+VkImageAspectFlags aspectOf(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_D16_UNORM:
+  case VK_FORMAT_X8_D24_UNORM_PACK32:
+  case VK_FORMAT_D32_SFLOAT:
+    return VK_IMAGE_ASPECT_DEPTH_BIT;
+  case VK_FORMAT_D16_UNORM_S8_UINT:
+  case VK_FORMAT_D24_UNORM_S8_UINT:
+  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  case VK_FORMAT_S8_UINT:
+    return VK_IMAGE_ASPECT_STENCIL_BIT;
+  default:
+    return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+bool isWritable(RenderGraph::Usage usage) {
+  return usage != RenderGraph::Usage::FragmentSampled &&
+         usage != RenderGraph::Usage::ComputeSampled &&
+         usage != RenderGraph::Usage::TransferSource;
+}
+
+// The layout, stages and accesses of an image used this way
+RenderGraph::ImageState stateOf(RenderGraph::Usage usage, bool write,
+                                VkImageAspectFlags aspect) {
+  auto const ifWritten = [write](VkAccessFlags access) -> VkAccessFlags {
+    return write ? access : 0;
+  };
+  bool const depth = (aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0;
+  VkImageLayout const sampledLayout =
+      depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+            : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  switch (usage) {
+  case RenderGraph::Usage::ColorAttachment:
+    return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                ifWritten(VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT)};
+  case RenderGraph::Usage::DepthAttachment:
+    return {write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                  : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                ifWritten(VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)};
+  case RenderGraph::Usage::FragmentSampled:
+    return {sampledLayout, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT};
+  case RenderGraph::Usage::ComputeSampled:
+    return {sampledLayout, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT};
+  case RenderGraph::Usage::ComputeStorage:
+    return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT |
+                ifWritten(VK_ACCESS_SHADER_WRITE_BIT)};
+  case RenderGraph::Usage::TransferSource:
+    return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT};
+  case RenderGraph::Usage::TransferDestination:
+    return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+  }
+  throw std::runtime_error("Failed to plan render graph: unknown usage");
+}
+
+VkImageUsageFlags imageUsageOf(RenderGraph::Usage usage) {
+  switch (usage) {
+  case RenderGraph::Usage::ColorAttachment:
+    return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  case RenderGraph::Usage::DepthAttachment:
+    return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  case RenderGraph::Usage::FragmentSampled:
+  case RenderGraph::Usage::ComputeSampled:
+    return VK_IMAGE_USAGE_SAMPLED_BIT;
+  case RenderGraph::Usage::ComputeStorage:
+    return VK_IMAGE_USAGE_STORAGE_BIT;
+  case RenderGraph::Usage::TransferSource:
+    return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  case RenderGraph::Usage::TransferDestination:
+    return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  }
+  return 0;
+}
+
+char const *layoutName(VkImageLayout layout) {
+  switch (layout) {
+  case VK_IMAGE_LAYOUT_UNDEFINED:
+    return "undefined";
+  case VK_IMAGE_LAYOUT_GENERAL:
+    return "general";
+  case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+    return "color attachment";
+  case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+    return "depth attachment";
+  case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+    return "depth read-only";
+  case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+    return "shader read-only";
+  case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+    return "transfer source";
+  case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+    return "transfer destination";
+  case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+    return "present";
+  default:
+    return "other";
+  }
+}
+
+} // namespace
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph &graph, uint32_t pass)
+    : m_graph(graph), m_pass(pass) {}
+
+void RenderGraph::PassBuilder::read(ResourceId image, Usage usage) {
+  if (image >= m_graph.m_images.size()) {
+    throw std::runtime_error("Failed to add pass: unknown image");
+  }
+  std::vector<Use> &uses = m_graph.m_passes[m_pass].uses;
+  for (Use const &use : uses) {
+    if (use.image == image) {
+      throw std::runtime_error("Failed to add pass: " +
+                               m_graph.m_images[image].name + " used twice");
+    }
+  }
+  uses.push_back({image, usage, false});
+}
+
+void RenderGraph::PassBuilder::write(ResourceId image, Usage usage) {
+  if (!isWritable(usage)) {
+    throw std::runtime_error("Failed to add pass: usage is read-only");
+  }
+  read(image, usage);
+  m_graph.m_passes[m_pass].uses.back().write = true;
+}
+
+void RenderGraph::PassBuilder::sideEffects() {
+  m_graph.m_passes[m_pass].sideEffects = true;
+}
+
+RenderGraph::RenderGraph(VkDevice device, MemoryAllocator &allocator)
+    : m_device(device), m_allocator(allocator) {}
+
+RenderGraph::~RenderGraph() {
+  for (Image const &image : m_images) {
+    if (image.imported)
+      continue;
+    for (VkImageView view : image.views) {
+      vkDestroyImageView(m_device, view, nullptr);
+    }
+    for (VkImage handle : image.images) {
+      vkDestroyImage(m_device, handle, nullptr);
+    }
+  }
+  for (MemoryAllocator::Allocation const &allocation : m_slotAllocations) {
+    m_allocator.free(allocation);
+  }
+}
+
+RenderGraph::ResourceId
+RenderGraph::importImage(std::string name, std::vector<VkImage> images,
+                         std::vector<VkImageView> views, VkFormat format,
+                         ImageState before, ImageState after) {
+  Image image{};
+  image.name = std::move(name);
+  image.format = format;
+  image.aspect = aspectOf(format);
+  image.imported = true;
+  image.images = std::move(images);
+  image.views = std::move(views);
+  image.before = before;
+  image.after = after;
+  m_images.push_back(std::move(image));
+  return static_cast<ResourceId>(m_images.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::createImage(std::string name,
+                                                 ImageDescription description) {
+  Image image{};
+  image.name = std::move(name);
+  image.format = description.format;
+  image.aspect = aspectOf(description.format);
+  image.imported = false;
+  image.extent = description.extent;
+  m_images.push_back(std::move(image));
+  return static_cast<ResourceId>(m_images.size() - 1);
+}
+
+void RenderGraph::addPass(
+    std::string name, std::function<void(PassBuilder &builder)> const &setup,
+    RecordFunction record) {
+  if (m_compiled) {
+    throw std::runtime_error("Failed to add pass: the graph is compiled");
+  }
+  m_passes.push_back({std::move(name), {}, false, std::move(record)});
+  PassBuilder builder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+  setup(builder);
+}
+
+void RenderGraph::compile() {
+  if (m_compiled) {
+    throw std::runtime_error("Failed to compile render graph: compiled twice");
+  }
+  m_compiled = true;
+
+  cullPasses();
+  allocateTransientImages();
+  planBarriers();
+
+  for (Step const &step : m_steps) {
+    ScheduledPass scheduled;
+    scheduled.name = step.pass == endStep ? "end" : m_passes[step.pass].name;
+    scheduled.srcStages = step.srcStages;
+    scheduled.dstStages = step.dstStages;
+    for (Barrier const &barrier : step.barriers) {
+      scheduled.barriers.push_back({m_images[barrier.image].name,
+                                    barrier.oldLayout, barrier.newLayout,
+                                    barrier.srcAccess, barrier.dstAccess});
+    }
+    m_schedule.push_back(std::move(scheduled));
+  }
+}
+
+// Walks the passes backwards, keeping those that write something a kept pass
+// reads later on
+void RenderGraph::cullPasses() {
+  std::vector<bool> needed(m_images.size(), false);
+  for (size_t i = 0; i < m_images.size(); i++) {
+    needed[i] = m_images[i].imported;
+  }
+
+  std::vector<bool> kept(m_passes.size(), false);
+  for (size_t i = m_passes.size(); i-- > 0;) {
+    Pass const &pass = m_passes[i];
+    kept[i] = pass.sideEffects;
+    for (Use const &use : pass.uses) {
+      if (use.write && needed[use.image])
+        kept[i] = true;
+    }
+    if (!kept[i])
+      continue;
+    for (Use const &use : pass.uses) {
+      if (!use.write)
+        needed[use.image] = true;
+    }
+  }
+
+  for (size_t i = 0; i < m_passes.size(); i++) {
+    if (kept[i])
+      m_order.push_back(static_cast<uint32_t>(i));
+    else
+      m_culledPasses.push_back(m_passes[i].name);
+  }
+}
+
+// Creates the transient images used by kept passes, then packs them into
+// slots greedily, largest first: an image joins the first slot whose
+// occupants are all done before it starts or start after it's done. Each
+// slot gets one allocation the size of its largest occupant.
+void RenderGraph::allocateTransientImages() {
+  std::vector<ResourceId> transients;
+  for (uint32_t position = 0; position < m_order.size(); position++) {
+    for (Use const &use : m_passes[m_order[position]].uses) {
+      Image &image = m_images[use.image];
+      if (image.imported)
+        continue;
+      image.usage |= imageUsageOf(use.usage);
+      if (image.firstPass == UINT32_MAX)
+        transients.push_back(use.image);
+      image.firstPass = std::min(image.firstPass, position);
+      image.lastPass = std::max(image.lastPass, position);
+    }
+  }
+
+  for (ResourceId id : transients) {
+    Image &image = m_images[id];
+
+    VkImageCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    // Required to bind memory that other images have used
+    info.flags = VK_IMAGE_CREATE_ALIAS_BIT;
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = image.format;
+    info.extent = {image.extent.width, image.extent.height, 1};
+    info.mipLevels = 1;
+    info.arrayLayers = 1;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = image.usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkImage handle;
+    if (vkCreateImage(m_device, &info, nullptr, &handle) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create image " + image.name);
+    }
+    image.images = {handle};
+    vkGetImageMemoryRequirements(m_device, handle, &image.requirements);
+  }
+
+  std::sort(transients.begin(), transients.end(),
+            [this](ResourceId a, ResourceId b) {
+              return m_images[a].requirements.size >
+                     m_images[b].requirements.size;
+            });
+
+  std::vector<VkMemoryRequirements> slots;
+  std::vector<std::vector<ResourceId>> occupants;
+  for (ResourceId id : transients) {
+    Image &image = m_images[id];
+    auto const fits = [this, &image](std::vector<ResourceId> const &others) {
+      for (ResourceId other : others) {
+        Image const &o = m_images[other];
+        if (o.firstPass <= image.lastPass && image.firstPass <= o.lastPass)
+          return false;
+      }
+      return true;
+    };
+
+    size_t slot = 0;
+    while (slot < slots.size() &&
+           ((slots[slot].memoryTypeBits & image.requirements.memoryTypeBits) ==
+                0 ||
+            !fits(occupants[slot]))) {
+      slot++;
+    }
+    if (slot == slots.size()) {
+      slots.push_back(image.requirements);
+      occupants.emplace_back();
+    } else {
+      slots[slot].size = std::max(slots[slot].size, image.requirements.size);
+      slots[slot].alignment =
+          std::max(slots[slot].alignment, image.requirements.alignment);
+      slots[slot].memoryTypeBits &= image.requirements.memoryTypeBits;
+    }
+    occupants[slot].push_back(id);
+    image.slot = static_cast<uint32_t>(slot);
+  }
+
+  for (size_t slot = 0; slot < slots.size(); slot++) {
+    m_slotAllocations.push_back(m_allocator.allocate(
+        slots[slot], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false));
+    MemoryAllocator::Allocation const &allocation = m_slotAllocations.back();
+
+    for (ResourceId id : occupants[slot]) {
+      Image &image = m_images[id];
+      if (vkBindImageMemory(m_device, image.images[0], allocation.memory,
+                            allocation.offset) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to bind memory of " + image.name);
+      }
+
+      VkImageViewCreateInfo viewInfo{};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = image.images[0];
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = image.format;
+      viewInfo.subresourceRange = {image.aspect, 0, 1, 0, 1};
+
+      VkImageView view;
+      if (vkCreateImageView(m_device, &viewInfo, nullptr, &view) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("Failed to create view of " + image.name);
+      }
+      image.views = {view};
+    }
+  }
+}
+
+// Follows every image through the kept passes. A transient image starts out
+// undefined, after whatever last used its slot.
+void RenderGraph::planBarriers() {
+  std::vector<Tracked> tracked(m_images.size());
+  for (size_t i = 0; i < m_images.size(); i++) {
+    Image const &image = m_images[i];
+    if (image.imported) {
+      tracked[i] = {image.before.layout, image.before.stages, 0, 0,
+                    image.before.stages, image.before.access};
+    } else {
+      tracked[i] = {VK_IMAGE_LAYOUT_UNDEFINED, 0, 0};
+    }
+  }
+
+  std::vector<ResourceId> slotUsers(m_slotAllocations.size(), UINT32_MAX);
+  for (uint32_t pass : m_order) {
+    Step step{pass};
+    for (Use const &use : m_passes[pass].uses) {
+      Image const &image = m_images[use.image];
+      if (!image.imported && slotUsers[image.slot] != use.image) {
+        // Taking over the slot: wait for the previous occupant, if any
+        if (slotUsers[image.slot] != UINT32_MAX) {
+          Tracked const &previous = tracked[slotUsers[image.slot]];
+          tracked[use.image].writeStages = previous.writeStages |
+                                           previous.readStages |
+                                           previous.visibleStages;
+          tracked[use.image].writeAccess = previous.writeAccess;
+        }
+        slotUsers[image.slot] = use.image;
+      }
+      addTransition(step, use.image, tracked[use.image],
+                    stateOf(use.usage, use.write, image.aspect), use.write);
+    }
+    m_steps.push_back(std::move(step));
+  }
+
+  Step end{endStep};
+  for (size_t i = 0; i < m_images.size(); i++) {
+    if (m_images[i].imported) {
+      addTransition(end, static_cast<ResourceId>(i), tracked[i],
+                    m_images[i].after, false);
+    }
+  }
+  if (!end.barriers.empty())
+    m_steps.push_back(std::move(end));
+}
+
+// Adds a barrier to `step` if `next` needs a layout transition, has to wait
+// for earlier accesses, or hasn't been made visible yet, then moves
+// `tracked` on past it
+void RenderGraph::addTransition(Step &step, ResourceId image, Tracked &tracked,
+                                ImageState const &next, bool write) {
+  bool const transition = tracked.layout != next.layout;
+  bool hazard;
+  if (write) {
+    hazard = (tracked.writeStages | tracked.readStages |
+              tracked.visibleStages) != 0;
+  } else {
+    hazard = tracked.writeStages != 0 &&
+             ((next.stages & ~tracked.visibleStages) != 0 ||
+              (next.access & ~tracked.visibleAccess) != 0);
+  }
+
+  if (transition || hazard) {
+    VkPipelineStageFlags srcStages =
+        tracked.writeStages | tracked.visibleStages;
+    if (write || transition)
+      srcStages |= tracked.readStages;
+    step.srcStages |= srcStages;
+    step.dstStages |= next.stages;
+    step.barriers.push_back({image, tracked.layout, next.layout,
+                             tracked.writeAccess, next.access});
+  }
+
+  if (write) {
+    tracked = {next.layout, next.stages, next.access & writeAccessMask};
+  } else if (transition) {
+    // The transition itself writes the image; later accesses chain on to it
+    tracked = {next.layout, next.stages, 0, next.stages, next.stages,
+               next.access};
+  } else {
+    tracked.readStages |= next.stages;
+    if (hazard) {
+      tracked.visibleStages |= next.stages;
+      tracked.visibleAccess |= next.access;
+    }
+  }
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t imageIndex,
+                          PassHook const &beforePass,
+                          PassHook const &afterPass) const {
+  if (!m_compiled) {
+    throw std::runtime_error("Failed to execute render graph: not compiled");
+  }
+
+  for (Step const &step : m_steps) {
+    recordBarriers(commandBuffer, step, imageIndex);
+    if (step.pass == endStep)
+      continue;
+
+    Pass const &pass = m_passes[step.pass];
+    if (beforePass)
+      beforePass(commandBuffer, pass.name);
+    pass.record(commandBuffer, imageIndex);
+    if (afterPass)
+      afterPass(commandBuffer, pass.name);
+  }
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer,
+                                 Step const &step, uint32_t imageIndex) const {
+  if (step.barriers.empty())
+    return;
+
+  std::vector<VkImageMemoryBarrier> barriers;
+  barriers.reserve(step.barriers.size());
+  for (Barrier const &planned : step.barriers) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = planned.srcAccess;
+    barrier.dstAccessMask = planned.dstAccess;
+    barrier.oldLayout = planned.oldLayout;
+    barrier.newLayout = planned.newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image(planned.image, imageIndex);
+    barrier.subresourceRange = {m_images[planned.image].aspect, 0,
+                                VK_REMAINING_MIP_LEVELS, 0,
+                                VK_REMAINING_ARRAY_LAYERS};
+    barriers.push_back(barrier);
+  }
+
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      step.srcStages != 0 ? step.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      step.dstStages != 0 ? step.dstStages
+                          : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()),
+      barriers.data());
+}
+
+VkImage RenderGraph::image(ResourceId image, uint32_t imageIndex) const {
+  std::vector<VkImage> const &images = m_images[image].images;
+  return images.size() == 1 ? images[0] : images[imageIndex];
+}
+
+VkImageView RenderGraph::view(ResourceId image, uint32_t imageIndex) const {
+  std::vector<VkImageView> const &views = m_images[image].views;
+  if (views.empty())
+    return VK_NULL_HANDLE;
+  return views.size() == 1 ? views[0] : views[imageIndex];
+}
+
+std::vector<RenderGraph::ScheduledPass> const &RenderGraph::schedule() const {
+  return m_schedule;
+}
+
+std::vector<std::string> const &RenderGraph::culledPasses() const {
+  return m_culledPasses;
+}
+
+std::vector<RenderGraph::TransientImage> RenderGraph::transientImages() const {
+  std::vector<TransientImage> transients;
+  for (Image const &image : m_images) {
+    if (image.imported || image.firstPass == UINT32_MAX)
+      continue;
+    transients.push_back({image.name, image.slot, image.requirements.size,
+                          image.firstPass, image.lastPass});
+  }
+  return transients;
+}
+
+void RenderGraph::writeSchedule(std::ostream &stream) const {
+  stream << "Render graph (" << m_order.size() << " passes, "
+         << m_culledPasses.size() << " culled):\n";
+  for (ScheduledPass const &pass : m_schedule) {
+    stream << '\t' << pass.name;
+    if (!pass.barriers.empty()) {
+      stream << ", barrier 0x" << std::hex << pass.srcStages << " -> 0x"
+             << pass.dstStages << std::dec;
+    }
+    stream << '\n';
+    for (ScheduledBarrier const &barrier : pass.barriers) {
+      stream << "\t\t" << barrier.image << ": "
+             << layoutName(barrier.oldLayout) << " -> "
+             << layoutName(barrier.newLayout) << ", access 0x" << std::hex
+             << barrier.srcAccess << " -> 0x" << barrier.dstAccess << std::dec
+             << '\n';
+    }
+  }
+  for (std::string const &name : m_culledPasses) {
+    stream << "\tculled " << name << '\n';
+  }
+  for (TransientImage const &transient : transientImages()) {
+    stream << "\ttransient " << transient.name << ": slot " << transient.slot
+           << ", " << transient.size << " bytes, passes "
+           << transient.firstPass << " to " << transient.lastPass << '\n';
+  }
+}
@@ -0,0 +1,67 @@
+#include "ShaderLibrary.hpp"
+
+#include "EmbeddedShaders.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+uint32_t const spirvMagic = 0x07230203;
+// Magic, version, generator, bound and schema
+size_t const spirvHeaderWords = 5;
+
+std::optional<ShaderLibrary::Code> mapSpirv(std::string const &filename) {
+  std::optional<Utils::MappedFile> file = Utils::MappedFile::open(filename);
+  if (!file)
+    return std::nullopt;
+
+  // Mappings are page-aligned, so the words can be used in place
+  uint32_t const *words = file->as<uint32_t>();
+  if (words == nullptr || file->count<uint32_t>() < spirvHeaderWords ||
+      words[0] != spirvMagic) {
+    std::cerr << "Ignoring " << filename << ": not a SPIR-V module"
+              << std::endl;
+    return std::nullopt;
+  }
+
+  ShaderLibrary::Code code;
+  code.words = words;
+  code.wordCount = file->count<uint32_t>();
+  code.file = std::move(file);
+  return code;
+}
+
+} // namespace
+
+ShaderLibrary::Code ShaderLibrary::load(std::string const &name,
+                                        std::string const &overrideDirectory) {
+  if (!overrideDirectory.empty()) {
+    std::filesystem::path const path =
+        std::filesystem::path(overrideDirectory) / (name + ".spv");
+    if (std::filesystem::exists(path)) {
+      if (std::optional<Code> code = mapSpirv(path.string()))
+        return std::move(*code);
+    }
+  }
+
+  for (EmbeddedShader const &shader : embeddedShaders) {
+    if (std::strcmp(shader.name, name.c_str()) == 0) {
+      Code code;
+      code.words = shader.code;
+      code.wordCount = shader.wordCount;
+      return code;
+    }
+  }
+  throw std::runtime_error("Failed to find shader " + name);
+}
+
+VkShaderModuleCreateInfo ShaderLibrary::moduleInfo(Code const &code) {
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = code.wordCount * sizeof(uint32_t);
+  createInfo.pCode = code.words;
+  return createInfo;
+}
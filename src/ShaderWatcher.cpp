@@ -0,0 +1,174 @@
+#include "ShaderWatcher.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <spawn.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+
+// Set by the build to the compiler the embedded shaders were built with
+#ifndef GLSLC_EXECUTABLE
+#define GLSLC_EXECUTABLE "glslc"
+#endif
+
+#ifdef __linux__
+
+extern char **environ;
+
+namespace {
+
+bool isShaderSource(std::string const &name) {
+  static char const *const extensions[] = {".vert", ".frag", ".comp",
+                                           ".geom", ".tesc", ".tese"};
+  std::string const extension =
+      std::filesystem::path(name).extension().string();
+  for (char const *candidate : extensions) {
+    if (extension == candidate)
+      return true;
+  }
+  return false;
+}
+
+} // namespace
+
+ShaderWatcher::ShaderWatcher(std::string sourceDirectory,
+                             std::string outputDirectory,
+                             ChangeFunction onChange)
+    : m_sourceDirectory(std::move(sourceDirectory)),
+      m_outputDirectory(std::move(outputDirectory)),
+      m_onChange(std::move(onChange)) {
+  if (m_outputDirectory.empty()) {
+    // Fresh for every run, so nothing compiled earlier overrides the shaders
+    // the binary was built with
+    std::string pattern =
+        (std::filesystem::temp_directory_path() / "shaders-XXXXXX").string();
+    if (mkdtemp(pattern.data()) == nullptr) {
+      throw std::runtime_error("Failed to create shader output directory");
+    }
+    m_outputDirectory = pattern;
+    m_ownsOutputDirectory = true;
+  } else {
+    std::filesystem::create_directories(m_outputDirectory);
+  }
+
+  m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_inotify < 0) {
+    throw std::runtime_error("Failed to initialize inotify");
+  }
+  // Editors either rewrite a file in place or rename a new one over it
+  if (inotify_add_watch(m_inotify, m_sourceDirectory.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(m_inotify);
+    throw std::runtime_error("Failed to watch " + m_sourceDirectory);
+  }
+
+  m_thread = std::thread([this]() { watchLoop(); });
+}
+
+ShaderWatcher::~ShaderWatcher() {
+  m_stopping = true;
+  if (m_thread.joinable())
+    m_thread.join();
+  close(m_inotify);
+
+  if (m_ownsOutputDirectory) {
+    // Mapped files outlive their directory entries, so shaders in use are fine
+    std::error_code error;
+    std::filesystem::remove_all(m_outputDirectory, error);
+  }
+}
+
+void ShaderWatcher::watchLoop() {
+  std::set<std::string> changed;
+
+  while (!m_stopping) {
+    // Saving can take several events; compile once they have settled
+    pollfd fd{m_inotify, POLLIN, 0};
+    int const ready = poll(&fd, 1, changed.empty() ? 200 : 50);
+    if (ready < 0 && errno != EINTR) {
+      std::cerr << "Stopped watching shaders: " << std::strerror(errno)
+                << std::endl;
+      return;
+    }
+
+    if (ready > 0) {
+      alignas(inotify_event) char buffer[4096];
+      ssize_t length;
+      while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0) {
+        for (char const *at = buffer; at < buffer + length;) {
+          auto const *event = reinterpret_cast<inotify_event const *>(at);
+          if (event->len > 0 && isShaderSource(event->name))
+            changed.insert(event->name);
+          at += sizeof(inotify_event) + event->len;
+        }
+      }
+      continue;
+    }
+
+    for (std::string const &name : changed) {
+      if (compile(name))
+        m_onChange(name);
+    }
+    changed.clear();
+  }
+}
+
+bool ShaderWatcher::compile(std::string const &name) const {
+  std::string const source =
+      (std::filesystem::path(m_sourceDirectory) / name).string();
+  std::string const output =
+      (std::filesystem::path(m_outputDirectory) / (name + ".spv")).string();
+  // Renamed into place once complete, so a reader never maps a partial file
+  std::string const tempOutput = output + ".tmp";
+
+  char const *const argv[] = {GLSLC_EXECUTABLE, "-o", tempOutput.c_str(),
+                              source.c_str(), nullptr};
+  pid_t pid;
+  if (posix_spawnp(&pid, GLSLC_EXECUTABLE, nullptr, nullptr,
+                   const_cast<char *const *>(argv), environ) != 0) {
+    std::cerr << "Failed to run " << GLSLC_EXECUTABLE << std::endl;
+    return false;
+  }
+
+  int status = 0;
+  pid_t waited;
+  do {
+    waited = waitpid(pid, &status, 0);
+  } while (waited < 0 && errno == EINTR);
+  // glslc already reported why
+  if (waited < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    return false;
+
+  std::error_code error;
+  std::filesystem::rename(tempOutput, output, error);
+  if (error) {
+    std::cerr << "Failed to replace " << output << ": " << error.message()
+              << std::endl;
+    return false;
+  }
+  std::cout << "Recompiled " << name << std::endl;
+  return true;
+}
+
+#else
+
+ShaderWatcher::ShaderWatcher(std::string sourceDirectory,
+                             std::string outputDirectory,
+                             ChangeFunction onChange) {
+  throw std::runtime_error("Watching shaders needs inotify, which is Linux "
+                           "only");
+}
+
+ShaderWatcher::~ShaderWatcher() = default;
+
+#endif
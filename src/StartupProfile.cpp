@@ -0,0 +1,65 @@
+#include "StartupProfile.hpp"
+
+#include <iomanip>
+
+StartupProfile::StartupProfile() : m_start(Clock::now()) {}
+
+void StartupProfile::record(std::string name, Clock::duration duration) {
+  double const endMs = milliseconds(Clock::now() - m_start);
+  double const durationMs = milliseconds(duration);
+  m_steps.push_back({std::move(name), endMs - durationMs, durationMs});
+}
+
+void StartupProfile::markFirstFrame() {
+  if (!m_firstFrameMs)
+    m_firstFrameMs = milliseconds(Clock::now() - m_start);
+}
+
+void StartupProfile::writeSummary(std::ostream &stream) const {
+  double totalMs = 0.0;
+  for (Step const &step : m_steps) {
+    totalMs += step.durationMs;
+  }
+
+  stream << "Startup steps (" << std::fixed << std::setprecision(3) << totalMs
+         << " ms):\n";
+  for (Step const &step : m_steps) {
+    stream << '\t' << std::left << std::setw(28) << step.name << std::right
+           << ' ' << std::setw(9) << step.durationMs << " ms\n";
+  }
+  if (m_firstFrameMs)
+    stream << "Time to first frame: " << *m_firstFrameMs << " ms\n";
+  stream << std::defaultfloat;
+}
+
+void StartupProfile::writeJson(std::ostream &stream) const {
+  stream << "{\n  \"steps\": [";
+
+  bool first = true;
+  for (Step const &step : m_steps) {
+    stream << (first ? "\n" : ",\n");
+    first = false;
+    stream << "    {\"name\": \"" << step.name
+           << "\", \"startMs\": " << step.startMs
+           << ", \"durationMs\": " << step.durationMs << "}";
+  }
+
+  stream << "\n  ]";
+  if (m_firstFrameMs)
+    stream << ",\n  \"firstFrameMs\": " << *m_firstFrameMs;
+  stream << "\n}\n";
+}
+
+void StartupProfile::writeCsv(std::ostream &stream) const {
+  stream << "step,start_ms,duration_ms\n";
+  for (Step const &step : m_steps) {
+    stream << step.name << ',' << step.startMs << ',' << step.durationMs
+           << '\n';
+  }
+  if (m_firstFrameMs)
+    stream << "first_frame," << *m_firstFrameMs << ",0\n";
+}
+
+double StartupProfile::milliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
@@ -0,0 +1,46 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount) {
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  m_workers.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++) {
+    m_workers.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_condition.notify_all();
+
+  for (std::thread &worker : m_workers) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::size() const { return m_workers.size(); }
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+
+      // Drain the queue before stopping so no future is left unresolved
+      if (m_tasks.empty())
+        return;
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop();
+    }
+    task();
+  }
+}
@@ -0,0 +1,198 @@
+#include "Timeline.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Core in Vulkan 1.2, otherwise from VK_KHR_timeline_semaphore
+template <typename Function>
+Function loadFunction(VkDevice device, char const *name) {
+  PFN_vkVoidFunction function = vkGetDeviceProcAddr(device, name);
+  if (function == nullptr) {
+    std::string const extensionName = std::string(name) + "KHR";
+    function = vkGetDeviceProcAddr(device, extensionName.c_str());
+  }
+  if (function == nullptr)
+    throw std::runtime_error(std::string("Failed to load ") + name);
+  return reinterpret_cast<Function>(function);
+}
+
+} // namespace
+
+Timeline::Timeline(VkDevice device, VkQueue queue, bool timelineSemaphores)
+    : m_device(device), m_queue(queue) {
+  if (!timelineSemaphores)
+    return;
+
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_semaphore) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to create timeline semaphore");
+  }
+
+  m_waitSemaphores =
+      loadFunction<PFN_vkWaitSemaphoresKHR>(m_device, "vkWaitSemaphores");
+  m_getSemaphoreCounterValue = loadFunction<PFN_vkGetSemaphoreCounterValueKHR>(
+      m_device, "vkGetSemaphoreCounterValue");
+}
+
+Timeline::~Timeline() {
+  waitIdle();
+
+  vkDestroySemaphore(m_device, m_semaphore, nullptr);
+  for (VkFence fence : m_freeFences) {
+    vkDestroyFence(m_device, fence, nullptr);
+  }
+}
+
+uint64_t Timeline::submit(Submission const &submission) {
+  uint64_t const point = m_lastSubmitted + 1;
+  bool const timeline = usesTimelineSemaphore();
+
+  std::vector<VkSemaphore> waitSemaphores = submission.waitSemaphores;
+  std::vector<VkPipelineStageFlags> waitStages = submission.waitStages;
+  // Binary semaphores ignore their values
+  std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+  for (Wait const &wait : submission.waits) {
+    if (wait.point == 0)
+      continue;
+    if (timeline) {
+      waitSemaphores.push_back(wait.timeline->m_semaphore);
+      waitStages.push_back(wait.stages);
+      waitValues.push_back(wait.point);
+    } else if (wait.timeline != this) {
+      wait.timeline->wait(wait.point);
+    }
+  }
+
+  std::vector<VkSemaphore> signalSemaphores = submission.signalSemaphores;
+  std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+  if (timeline) {
+    signalSemaphores.push_back(m_semaphore);
+    signalValues.push_back(point);
+  }
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount =
+      static_cast<uint32_t>(waitValues.size());
+  timelineInfo.pWaitSemaphoreValues = waitValues.data();
+  timelineInfo.signalSemaphoreValueCount =
+      static_cast<uint32_t>(signalValues.size());
+  timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = timeline ? &timelineInfo : nullptr;
+  submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  submitInfo.commandBufferCount =
+      static_cast<uint32_t>(submission.commandBuffers.size());
+  submitInfo.pCommandBuffers = submission.commandBuffers.data();
+  submitInfo.signalSemaphoreCount =
+      static_cast<uint32_t>(signalSemaphores.size());
+  submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+  VkFence fence = VK_NULL_HANDLE;
+  if (!timeline) {
+    if (m_freeFences.empty()) {
+      VkFenceCreateInfo fenceInfo{};
+      fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+      if (vkCreateFence(m_device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create fence");
+      }
+    } else {
+      fence = m_freeFences.back();
+      m_freeFences.pop_back();
+    }
+  }
+
+  if (vkQueueSubmit(m_queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+    if (fence != VK_NULL_HANDLE)
+      m_freeFences.push_back(fence);
+    throw std::runtime_error("Failed to submit command buffers");
+  }
+
+  if (fence != VK_NULL_HANDLE)
+    m_pendingFences.push_back({point, fence});
+  m_lastSubmitted = point;
+  return point;
+}
+
+uint64_t Timeline::lastSubmitted() const { return m_lastSubmitted; }
+
+uint64_t Timeline::completedPoint() {
+  if (usesTimelineSemaphore()) {
+    uint64_t value = m_completed;
+    m_getSemaphoreCounterValue(m_device, m_semaphore, &value);
+    m_completed = std::max(m_completed, value);
+    return m_completed;
+  }
+
+  // The newest signaled fence stands for every submission before it
+  for (size_t i = m_pendingFences.size(); i-- > 0;) {
+    if (vkGetFenceStatus(m_device, m_pendingFences[i].fence) == VK_SUCCESS) {
+      retireFences(i + 1);
+      break;
+    }
+  }
+  return m_completed;
+}
+
+bool Timeline::isComplete(uint64_t point) {
+  return point <= m_completed || point <= completedPoint();
+}
+
+void Timeline::wait(uint64_t point) {
+  if (point <= m_completed)
+    return;
+
+  if (usesTimelineSemaphore()) {
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_semaphore;
+    waitInfo.pValues = &point;
+    if (m_waitSemaphores(m_device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to wait for timeline semaphore");
+    }
+    m_completed = point;
+    return;
+  }
+
+  // Every submission has a fence, so the points pending are consecutive
+  size_t const index =
+      static_cast<size_t>(point - m_pendingFences.front().point);
+  if (vkWaitForFences(m_device, 1, &m_pendingFences[index].fence, VK_TRUE,
+                      UINT64_MAX) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to wait for fence");
+  }
+  retireFences(index + 1);
+}
+
+void Timeline::waitIdle() { wait(m_lastSubmitted); }
+
+bool Timeline::usesTimelineSemaphore() const {
+  return m_semaphore != VK_NULL_HANDLE;
+}
+
+void Timeline::retireFences(size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    PendingFence const pending = m_pendingFences.front();
+    m_pendingFences.pop_front();
+    vkResetFences(m_device, 1, &pending.fence);
+    m_freeFences.push_back(pending.fence);
+    m_completed = pending.point;
+  }
+}
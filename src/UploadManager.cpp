@@ -0,0 +1,414 @@
+#include "UploadManager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Covers every texel size, so image copies can start at any reservation
+VkDeviceSize const imageAlignment = 16;
+VkDeviceSize const bufferAlignment = 4;
+
+} // namespace
+
+UploadManager::UploadManager(VkDevice device, MemoryAllocator &allocator,
+                             uint32_t transferFamily,
+                             Timeline &transferTimeline,
+                             uint32_t graphicsFamily,
+                             Timeline &graphicsTimeline, VkDeviceSize ringSize)
+    : m_device(device), m_allocator(allocator),
+      m_transferFamily(transferFamily), m_transferTimeline(transferTimeline),
+      m_graphicsFamily(graphicsFamily), m_graphicsTimeline(graphicsTimeline),
+      m_ringSize(ringSize) {
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = m_ringSize;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_ring) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create staging buffer");
+  }
+  m_ringAllocation = m_allocator.allocateForBuffer(
+      m_ring, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  for (Batch &batch : m_batches) {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = m_transferFamily;
+
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr,
+                            &batch.transferPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create command pool");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = batch.transferPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(m_device, &allocInfo,
+                                 &batch.transferCommandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate command buffer");
+    }
+
+    // Without a dedicated transfer queue ownership never changes hands
+    if (!dedicatedTransferQueue())
+      continue;
+
+    poolInfo.queueFamilyIndex = m_graphicsFamily;
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &batch.acquirePool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("Failed to create command pool");
+    }
+
+    allocInfo.commandPool = batch.acquirePool;
+    if (vkAllocateCommandBuffers(m_device, &allocInfo,
+                                 &batch.acquireCommandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate command buffer");
+    }
+  }
+}
+
+UploadManager::~UploadManager() {
+  waitIdle();
+
+  for (Batch &batch : m_batches) {
+    vkDestroyCommandPool(m_device, batch.acquirePool, nullptr);
+    vkDestroyCommandPool(m_device, batch.transferPool, nullptr);
+  }
+
+  vkDestroyBuffer(m_device, m_ring, nullptr);
+  m_allocator.free(m_ringAllocation);
+}
+
+void UploadManager::uploadBuffer(VkBuffer buffer, VkDeviceSize offset,
+                                 void const *data, VkDeviceSize size,
+                                 bool concurrent) {
+  auto const *bytes = static_cast<char const *>(data);
+
+  while (size > 0) {
+    VkDeviceSize const chunk = std::min(size, m_ringSize);
+    VkDeviceSize const ringOffset = reserve(chunk, bufferAlignment);
+    Batch &batch = recordingBatch();
+
+    std::memcpy(static_cast<char *>(m_ringAllocation.mapped) + ringOffset,
+                bytes, chunk);
+
+    VkBufferCopy region{};
+    region.srcOffset = ringOffset;
+    region.dstOffset = offset;
+    region.size = chunk;
+    vkCmdCopyBuffer(batch.transferCommandBuffer, m_ring, buffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = chunk;
+    if (concurrent)
+      batch.concurrentBufferBarriers.push_back(barrier);
+    else
+      batch.bufferBarriers.push_back(barrier);
+
+    bytes += chunk;
+    offset += chunk;
+    size -= chunk;
+  }
+}
+
+void UploadManager::uploadImage(VkImage image, VkExtent3D extent,
+                                void const *data, VkDeviceSize size,
+                                VkImageLayout finalLayout) {
+  if (size > m_ringSize) {
+    throw std::runtime_error("Image upload is larger than the staging ring");
+  }
+
+  VkDeviceSize const ringOffset = reserve(size, imageAlignment);
+  Batch &batch = recordingBatch();
+
+  std::memcpy(static_cast<char *>(m_ringAllocation.mapped) + ringOffset, data,
+              size);
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(batch.transferCommandBuffer,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = ringOffset;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = extent;
+  vkCmdCopyBufferToImage(batch.transferCommandBuffer, m_ring, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = finalLayout;
+  batch.imageBarriers.push_back(barrier);
+}
+
+uint64_t UploadManager::flush() {
+  if (m_recording == batchCount)
+    return m_nextTicket - 1;
+
+  Batch &batch = m_batches[m_recording];
+  bool const dedicated = dedicatedTransferQueue();
+
+  // Release to the graphics family, or with a shared queue make the writes
+  // visible to whatever runs next
+  for (VkBufferMemoryBarrier &barrier : batch.bufferBarriers) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dedicated ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+    barrier.srcQueueFamilyIndex =
+        dedicated ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex =
+        dedicated ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+  }
+  for (VkImageMemoryBarrier &barrier : batch.imageBarriers) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dedicated ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+    barrier.srcQueueFamilyIndex =
+        dedicated ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex =
+        dedicated ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+  }
+
+  // Concurrent buffers need no ownership transfer, only their writes made
+  // available; the acquire submission still orders them before graphics work
+  std::vector<VkBufferMemoryBarrier> bufferBarriers = batch.bufferBarriers;
+  for (VkBufferMemoryBarrier barrier : batch.concurrentBufferBarriers) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarriers.push_back(barrier);
+  }
+
+  vkCmdPipelineBarrier(
+      batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      dedicated && batch.concurrentBufferBarriers.empty()
+          ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+          : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()),
+      bufferBarriers.data(), static_cast<uint32_t>(batch.imageBarriers.size()),
+      batch.imageBarriers.data());
+
+  if (vkEndCommandBuffer(batch.transferCommandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record upload command buffer");
+  }
+
+  Timeline::Submission submission;
+  submission.commandBuffers = {batch.transferCommandBuffer};
+  batch.transferPoint = m_transferTimeline.submit(submission);
+
+  batch.state = BatchState::Transferring;
+  m_inFlight.push_back(m_recording);
+  m_recording = batchCount;
+  return m_nextTicket++;
+}
+
+void UploadManager::update() { retire(false); }
+
+bool UploadManager::isComplete(uint64_t ticket) const {
+  return ticket <= m_completedTicket;
+}
+
+void UploadManager::waitIdle() {
+  flush();
+  while (!m_inFlight.empty()) {
+    retire(true);
+  }
+}
+
+bool UploadManager::dedicatedTransferQueue() const {
+  return m_transferFamily != m_graphicsFamily;
+}
+
+uint32_t UploadManager::transferFamily() const { return m_transferFamily; }
+
+UploadManager::Batch &UploadManager::recordingBatch() {
+  if (m_recording != batchCount)
+    return m_batches[m_recording];
+
+  auto freeBatch = [this]() {
+    for (size_t i = 0; i < batchCount; i++) {
+      if (m_batches[i].state == BatchState::Free)
+        return i;
+    }
+    return batchCount;
+  };
+
+  size_t index = freeBatch();
+  while (index == batchCount) {
+    retire(true);
+    index = freeBatch();
+  }
+
+  Batch &batch = m_batches[index];
+  vkResetCommandPool(m_device, batch.transferPool, 0);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(batch.transferCommandBuffer, &beginInfo) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin recording upload commands");
+  }
+
+  batch.state = BatchState::Recording;
+  batch.ticket = m_nextTicket;
+  batch.ringEnd = m_ringHead;
+  batch.ringBytes = 0;
+  batch.bufferBarriers.clear();
+  batch.concurrentBufferBarriers.clear();
+  batch.imageBarriers.clear();
+  m_recording = index;
+  return batch;
+}
+
+VkDeviceSize UploadManager::reserve(VkDeviceSize size,
+                                    VkDeviceSize alignment) {
+  while (true) {
+    // Taking a batch may retire older ones, so do it before looking at the
+    // ring
+    Batch &batch = recordingBatch();
+
+    if (m_ringUsed == 0) {
+      m_ringHead = 0;
+      m_ringTail = 0;
+    }
+
+    VkDeviceSize offset = alignUp(m_ringHead, alignment);
+    bool fits;
+    if (m_ringUsed == 0 || m_ringHead > m_ringTail) {
+      // Free space runs from the head to the end, then from 0 to the tail
+      fits = offset + size <= m_ringSize;
+      if (!fits && size <= m_ringTail) {
+        offset = 0;
+        fits = true;
+      }
+    } else {
+      fits = offset + size <= m_ringTail;
+    }
+
+    if (fits) {
+      VkDeviceSize const consumed = offset >= m_ringHead
+                                        ? offset + size - m_ringHead
+                                        : m_ringSize - m_ringHead + size;
+      m_ringHead = offset + size;
+      m_ringUsed += consumed;
+
+      batch.ringEnd = m_ringHead;
+      batch.ringBytes += consumed;
+      return offset;
+    }
+
+    // The ring is full, so wait for the oldest uploads to drain
+    if (m_inFlight.empty()) {
+      flush();
+    }
+    retire(true);
+  }
+}
+
+void UploadManager::submitAcquire(Batch &batch) {
+  vkResetCommandPool(m_device, batch.acquirePool, 0);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(batch.acquireCommandBuffer, &beginInfo) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin recording acquire commands");
+  }
+
+  // Same barriers as the release, now from the receiving side
+  for (VkBufferMemoryBarrier &barrier : batch.bufferBarriers) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+  }
+  for (VkImageMemoryBarrier &barrier : batch.imageBarriers) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+  }
+
+  vkCmdPipelineBarrier(
+      batch.acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+      static_cast<uint32_t>(batch.bufferBarriers.size()),
+      batch.bufferBarriers.data(),
+      static_cast<uint32_t>(batch.imageBarriers.size()),
+      batch.imageBarriers.data());
+
+  if (vkEndCommandBuffer(batch.acquireCommandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record acquire commands");
+  }
+
+  // The transfer has already finished, so this wait never stalls the queue,
+  // nor the CPU without timeline semaphores
+  Timeline::Submission submission;
+  submission.commandBuffers = {batch.acquireCommandBuffer};
+  submission.waits = {{&m_transferTimeline, batch.transferPoint,
+                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT}};
+  batch.acquirePoint = m_graphicsTimeline.submit(submission);
+
+  batch.state = BatchState::Acquiring;
+}
+
+void UploadManager::retire(bool wait) {
+  while (!m_inFlight.empty()) {
+    Batch &batch = m_batches[m_inFlight.front()];
+
+    if (batch.state == BatchState::Transferring) {
+      if (wait) {
+        m_transferTimeline.wait(batch.transferPoint);
+      } else if (!m_transferTimeline.isComplete(batch.transferPoint)) {
+        return;
+      }
+
+      if (dedicatedTransferQueue()) {
+        submitAcquire(batch);
+      }
+    }
+
+    if (batch.state == BatchState::Acquiring) {
+      if (wait) {
+        m_graphicsTimeline.wait(batch.acquirePoint);
+      } else if (!m_graphicsTimeline.isComplete(batch.acquirePoint)) {
+        return;
+      }
+    }
+
+    m_ringTail = batch.ringEnd;
+    m_ringUsed -= batch.ringBytes;
+    m_completedTicket = batch.ticket;
+    batch.state = BatchState::Free;
+    m_inFlight.pop_front();
+
+    if (wait)
+      return;
+  }
+}
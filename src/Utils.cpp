@@ -1 +1,187 @@
-#include "Utils.hpp"
\ No newline at end of file
+#include "Utils.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define UTILS_HAS_MMAP
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+namespace Utils {
+
+std::optional<MappedFile> MappedFile::open(std::string const &filename) {
+  MappedFile file;
+
+#ifdef UTILS_HAS_MMAP
+  int const fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "Failed to open " << filename << ": " << std::strerror(errno)
+              << std::endl;
+    return std::nullopt;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    std::cerr << "Failed to stat " << filename << ": " << std::strerror(errno)
+              << std::endl;
+    close(fd);
+    return std::nullopt;
+  }
+
+  // mmap rejects empty mappings, and an empty file needs none
+  if (status.st_size > 0) {
+    size_t const size = static_cast<size_t>(status.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      std::cerr << "Failed to map " << filename << ": "
+                << std::strerror(errno) << std::endl;
+      close(fd);
+      return std::nullopt;
+    }
+    // Assets are consumed right away, so start paging them in
+    madvise(data, size, MADV_WILLNEED);
+    file.m_data = data;
+    file.m_size = size;
+  }
+  // The mapping keeps the file referenced
+  close(fd);
+#else
+  std::ifstream stream(filename, std::ios::ate | std::ios::binary);
+  if (!stream) {
+    std::cerr << "Failed to open " << filename << std::endl;
+    return std::nullopt;
+  }
+
+  size_t const size = static_cast<size_t>(stream.tellg());
+  file.m_fallback.resize((size + sizeof(std::max_align_t) - 1) /
+                         sizeof(std::max_align_t));
+  stream.seekg(0);
+  stream.read(reinterpret_cast<char *>(file.m_fallback.data()), size);
+  if (!stream) {
+    std::cerr << "Failed to read " << filename << std::endl;
+    return std::nullopt;
+  }
+  file.m_data = file.m_fallback.data();
+  file.m_size = size;
+#endif
+
+  return file;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_data(other.m_data), m_size(other.m_size),
+      m_fallback(std::move(other.m_fallback)) {
+  other.m_data = nullptr;
+  other.m_size = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    release();
+    m_data = other.m_data;
+    m_size = other.m_size;
+    m_fallback = std::move(other.m_fallback);
+    other.m_data = nullptr;
+    other.m_size = 0;
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() { release(); }
+
+void MappedFile::release() {
+#ifdef UTILS_HAS_MMAP
+  if (m_data != nullptr)
+    munmap(const_cast<void *>(m_data), m_size);
+#endif
+  m_data = nullptr;
+  m_size = 0;
+  m_fallback.clear();
+}
+
+bool writeFileAtomic(std::string const &filename, void const *data,
+                     size_t size) {
+  // Unique per call, so concurrent writers never share a temporary file
+  std::random_device random;
+  std::ostringstream suffix;
+  suffix << std::hex << (uint64_t(random()) << 32 | random());
+  std::string const tempFilename = filename + "." + suffix.str() + ".tmp";
+
+#ifdef UTILS_HAS_MMAP
+  int const fd = ::open(tempFilename.c_str(),
+                        O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "Failed to open " << tempFilename << ": "
+              << std::strerror(errno) << std::endl;
+    return false;
+  }
+
+  char const *bytes = static_cast<char const *>(data);
+  size_t written = 0;
+  while (written < size) {
+    ssize_t const result = ::write(fd, bytes + written, size - written);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result < 0)
+      break;
+    written += static_cast<size_t>(result);
+  }
+  // The data has to be on disk before the rename is, or a crash could leave
+  // the destination renamed but empty
+  bool const synced = written == size && fsync(fd) == 0;
+  if (close(fd) != 0 || !synced) {
+    std::cerr << "Failed to write " << tempFilename << ": "
+              << std::strerror(errno) << std::endl;
+    ::unlink(tempFilename.c_str());
+    return false;
+  }
+#else
+  {
+    std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      std::cerr << "Failed to open " << tempFilename << std::endl;
+      return false;
+    }
+    file.write(static_cast<char const *>(data), size);
+    file.close();
+    if (!file) {
+      std::cerr << "Failed to write " << tempFilename << std::endl;
+      std::error_code error;
+      std::filesystem::remove(tempFilename, error);
+      return false;
+    }
+  }
+#endif
+
+  std::error_code error;
+  std::filesystem::rename(tempFilename, filename, error);
+  if (error) {
+    std::cerr << "Failed to replace " << filename << ": " << error.message()
+              << std::endl;
+    std::filesystem::remove(tempFilename, error);
+    return false;
+  }
+
+#ifdef UTILS_HAS_MMAP
+  // Makes the rename itself durable
+  std::string directory =
+      std::filesystem::path(filename).parent_path().string();
+  if (directory.empty())
+    directory = ".";
+  int const directoryFd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+  if (directoryFd >= 0) {
+    fsync(directoryFd);
+    close(directoryFd);
+  }
+#endif
+  return true;
+}
+
+} // namespace Utils
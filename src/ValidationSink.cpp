@@ -0,0 +1,190 @@
+#include "ValidationSink.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// How long the writer thread sleeps when the ring is empty
+constexpr std::chrono::milliseconds pollInterval{2};
+
+char const *severityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity) {
+  switch (severity) {
+  case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
+    return "verbose";
+  case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
+    return "info";
+  case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
+    return "warning";
+  default:
+    return "error";
+  }
+}
+
+// Copies as much of `source` as fits, always terminated
+void copyString(char *destination, size_t size, char const *source) {
+  if (source == nullptr)
+    source = "";
+  size_t const length = std::min(std::strlen(source), size - 1);
+  std::memcpy(destination, source, length);
+  destination[length] = '\0';
+}
+
+} // namespace
+
+ValidationSink::ValidationSink(VkDebugUtilsMessageSeverityFlagsEXT severities,
+                               VkDebugUtilsMessageTypeFlagsEXT types,
+                               std::string const &outputPath)
+    : m_severities(severities), m_types(types),
+      m_slots(std::make_unique<Slot[]>(slotCount)), m_output(&std::cerr) {
+  static_assert((slotCount & (slotCount - 1)) == 0,
+                "slotCount must be a power of two");
+
+  for (size_t i = 0; i < slotCount; i++) {
+    m_slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  if (!outputPath.empty()) {
+    m_file.open(outputPath);
+    if (!m_file) {
+      throw std::runtime_error("Failed to open " + outputPath);
+    }
+    m_output = &m_file;
+  }
+
+  m_thread = std::thread([this]() { drainLoop(); });
+}
+
+ValidationSink::~ValidationSink() {
+  m_stopping = true;
+  if (m_thread.joinable())
+    m_thread.join();
+
+  std::vector<Repeats const *> repeated;
+  for (auto const &[key, repeats] : m_seen) {
+    if (repeats.count > 0)
+      repeated.push_back(&repeats);
+  }
+  std::sort(repeated.begin(), repeated.end(),
+            [](Repeats const *a, Repeats const *b) {
+              return a->count > b->count;
+            });
+  for (Repeats const *repeats : repeated) {
+    *m_output << "Validation layer: " << repeats->count
+              << " more of " << repeats->idName << '\n';
+  }
+  m_output->flush();
+}
+
+void ValidationSink::setFilter(VkDebugUtilsMessageSeverityFlagsEXT severities,
+                               VkDebugUtilsMessageTypeFlagsEXT types) {
+  m_severities.store(severities, std::memory_order_relaxed);
+  m_types.store(types, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL ValidationSink::callback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+    VkDebugUtilsMessageTypeFlagsEXT type,
+    VkDebugUtilsMessengerCallbackDataEXT const *callbackData,
+    void *userData) {
+  auto *sink = static_cast<ValidationSink *>(userData);
+  if (sink != nullptr && callbackData != nullptr)
+    sink->push(severity, type, *callbackData);
+  return VK_FALSE;
+}
+
+void ValidationSink::push(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+                          VkDebugUtilsMessageTypeFlagsEXT type,
+                          VkDebugUtilsMessengerCallbackDataEXT const &data) {
+  if ((m_severities.load(std::memory_order_relaxed) & severity) == 0 ||
+      (m_types.load(std::memory_order_relaxed) & type) == 0)
+    return;
+
+  // Claim the slot at the enqueue position, unless the writer hasn't freed
+  // it yet
+  size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+  Slot *slot;
+  while (true) {
+    slot = &m_slots[position & (slotCount - 1)];
+    size_t const sequence = slot->sequence.load(std::memory_order_acquire);
+    auto const difference = static_cast<std::ptrdiff_t>(sequence - position);
+    if (difference == 0) {
+      if (m_enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                  std::memory_order_relaxed))
+        break;
+    } else if (difference < 0) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      position = m_enqueuePosition.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->severity = severity;
+  slot->type = type;
+  slot->key = data.messageIdNumber != 0
+                  ? static_cast<uint32_t>(data.messageIdNumber)
+                  : std::hash<std::string_view>()(
+                        data.pMessage != nullptr ? data.pMessage : "");
+  copyString(slot->idName, idNameLength, data.pMessageIdName);
+  copyString(slot->message, messageLength, data.pMessage);
+  slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void ValidationSink::drainLoop() {
+  while (!m_stopping) {
+    if (!drain())
+      std::this_thread::sleep_for(pollInterval);
+  }
+  // Producers are done by now; the instance is gone before the sink is
+  drain();
+}
+
+bool ValidationSink::drain() {
+  bool wrote = false;
+  while (true) {
+    Slot &slot = m_slots[m_dequeuePosition & (slotCount - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) !=
+        m_dequeuePosition + 1)
+      break;
+
+    write(slot);
+    slot.sequence.store(m_dequeuePosition + slotCount,
+                        std::memory_order_release);
+    m_dequeuePosition++;
+    wrote = true;
+  }
+
+  uint64_t const dropped = m_dropped.load(std::memory_order_relaxed);
+  if (dropped != m_droppedReported) {
+    *m_output << "Validation layer: dropped " << dropped - m_droppedReported
+              << " messages, the queue was full\n";
+    m_droppedReported = dropped;
+    wrote = true;
+  }
+
+  if (wrote)
+    m_output->flush();
+  return wrote;
+}
+
+void ValidationSink::write(Slot const &slot) {
+  auto const [entry, first] = m_seen.try_emplace(slot.key);
+  if (!first) {
+    entry->second.count++;
+    return;
+  }
+
+  entry->second.idName = slot.idName[0] != '\0'
+                             ? std::string(slot.idName)
+                             : std::string(std::string_view(slot.message)
+                                               .substr(0, idNameLength));
+  *m_output << "Validation layer [" << severityName(slot.severity)
+            << "]: " << slot.message << '\n';
+}
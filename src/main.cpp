@@ -1,15 +1,278 @@
 #include "Application.hpp"
 #include "MainWindow.hpp"
+#include "Settings.hpp"
 
 #include <GLFW/glfw3.h>
 
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <string>
 
-int main(int, char **) {
+static void printUsage(std::ostream &stream) {
+  stream << R"(Usage: VulkanFunStuff [options]
+
+Device:
+  --device <index or name>     GPU to render on
+  --benchmark-devices          rank GPUs by a short benchmark
+  --device-benchmark-cache <path>
+  --no-timeline-semaphores     synchronize queues with fences
+  --no-dynamic-rendering       render with a render pass and framebuffers
+  --no-bindless                bind descriptor sets per scene
+  --async-compute
+  --no-async-compute           cull on the graphics queue
+
+Frame:
+  --frames-in-flight <n>       at least 1
+  --record-mode <per-frame|prerecorded|parallel>
+  --record-threads <n>         0 uses every hardware thread
+  --present-mode <immediate|mailbox|fifo|fifo-relaxed>
+  --fps-limit <fps>            0 leaves it unlimited
+  --width <pixels>             at least 1
+  --height <pixels>            at least 1
+  --headless                   render offscreen
+  --frames <n>                 frames rendered when headless
+
+Scene:
+  --draws <n>
+  --draw-path <direct|indirect>
+  --instances <n>              implies --draw-path indirect
+  --cull <off|frustum|occlusion>
+  --depth-shading
+  --zoom <factor>
+
+Shaders and pipelines:
+  --shader-dir <path>
+  --watch-shaders <source path>
+  --pipeline-cache <path>
+
+Diagnostics:
+  --profile
+  --profile-output <path>
+  --startup-profile-output <path>
+  --print-render-graph
+  --validation-level <verbose|info|warning|error>
+  --no-validation-performance
+  --validation-output <path>
+  --help
+)";
+}
+
+[[noreturn]] static void exitWithUsage(std::string const &error) {
+  std::cerr << error << "\n\n";
+  printUsage(std::cerr);
+  exit(EXIT_FAILURE);
+}
+
+// std::stoul alone accepts "-1", trailing garbage and values past 32 bits
+static uint32_t parseCount(std::string const &option, std::string const &value,
+                           uint32_t minimum) {
+  size_t end = 0;
+  unsigned long long parsed = 0;
+  bool valid = !value.empty() &&
+               std::isdigit(static_cast<unsigned char>(value[0])) != 0;
+  if (valid) {
+    try {
+      parsed = std::stoull(value, &end);
+    } catch (std::exception const &) {
+      valid = false;
+    }
+  }
+  if (!valid || end != value.size() || parsed > UINT32_MAX) {
+    exitWithUsage("Invalid value " + value + " for " + option);
+  }
+  if (parsed < minimum) {
+    exitWithUsage(option + " must be at least " + std::to_string(minimum));
+  }
+  return static_cast<uint32_t>(parsed);
+}
+
+static double parseNumber(std::string const &option,
+                          std::string const &value) {
+  size_t end = 0;
+  double parsed = 0.0;
+  try {
+    parsed = std::stod(value, &end);
+  } catch (std::exception const &) {
+    end = 0;
+  }
+  if (end == 0 || end != value.size() || !std::isfinite(parsed)) {
+    exitWithUsage("Invalid value " + value + " for " + option);
+  }
+  return parsed;
+}
+
+static Settings parseSettings(int argc, char **argv) {
+  Settings settings;
+
+  for (int i = 1; i < argc; i++) {
+    const auto nextValue = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        exitWithUsage(std::string("Missing value for ") + argv[i]);
+      }
+      return argv[++i];
+    };
+    const auto nextCount = [&](uint32_t minimum) {
+      std::string const option = argv[i];
+      return parseCount(option, nextValue(), minimum);
+    };
+    const auto nextNumber = [&]() {
+      std::string const option = argv[i];
+      return parseNumber(option, nextValue());
+    };
+
+    if (strcmp(argv[i], "--help") == 0) {
+      printUsage(std::cout);
+      exit(EXIT_SUCCESS);
+    } else if (strcmp(argv[i], "--device") == 0) {
+      settings.device = nextValue();
+      if (settings.device.empty())
+        exitWithUsage("--device needs an index or part of a GPU name");
+    } else if (strcmp(argv[i], "--benchmark-devices") == 0) {
+      settings.benchmarkDevices = true;
+    } else if (strcmp(argv[i], "--device-benchmark-cache") == 0) {
+      settings.deviceBenchmarkCachePath = nextValue();
+    } else if (strcmp(argv[i], "--frames-in-flight") == 0) {
+      settings.framesInFlight = nextCount(1);
+    } else if (strcmp(argv[i], "--record-mode") == 0) {
+      std::string const mode = nextValue();
+      if (mode == "per-frame") {
+        settings.recordMode = RecordMode::PerFrame;
+      } else if (mode == "prerecorded") {
+        settings.recordMode = RecordMode::Prerecorded;
+      } else if (mode == "parallel") {
+        settings.recordMode = RecordMode::Parallel;
+      } else {
+        exitWithUsage("Unknown record mode " + mode);
+      }
+    } else if (strcmp(argv[i], "--record-threads") == 0) {
+      settings.recordThreads = nextCount(0);
+    } else if (strcmp(argv[i], "--draws") == 0) {
+      settings.drawCount = nextCount(0);
+    } else if (strcmp(argv[i], "--draw-path") == 0) {
+      std::string const path = nextValue();
+      if (path == "direct") {
+        settings.drawPath = DrawPath::Direct;
+      } else if (path == "indirect") {
+        settings.drawPath = DrawPath::Indirect;
+      } else {
+        exitWithUsage("Unknown draw path " + path);
+      }
+    } else if (strcmp(argv[i], "--instances") == 0) {
+      settings.drawPath = DrawPath::Indirect;
+      settings.instanceCount = nextCount(0);
+    } else if (strcmp(argv[i], "--cull") == 0) {
+      std::string const mode = nextValue();
+      if (mode == "off") {
+        settings.cullMode = CullMode::Off;
+      } else if (mode == "frustum") {
+        settings.cullMode = CullMode::Frustum;
+      } else if (mode == "occlusion") {
+        settings.cullMode = CullMode::Occlusion;
+      } else {
+        exitWithUsage("Unknown cull mode " + mode);
+      }
+      if (settings.cullMode != CullMode::Off)
+        settings.drawPath = DrawPath::Indirect;
+    } else if (strcmp(argv[i], "--async-compute") == 0) {
+      settings.asyncCompute = true;
+    } else if (strcmp(argv[i], "--no-async-compute") == 0) {
+      settings.asyncCompute = false;
+    } else if (strcmp(argv[i], "--no-timeline-semaphores") == 0) {
+      settings.timelineSemaphores = false;
+    } else if (strcmp(argv[i], "--no-dynamic-rendering") == 0) {
+      settings.dynamicRendering = false;
+    } else if (strcmp(argv[i], "--no-bindless") == 0) {
+      settings.bindless = false;
+    } else if (strcmp(argv[i], "--depth-shading") == 0) {
+      settings.depthShading = true;
+    } else if (strcmp(argv[i], "--zoom") == 0) {
+      settings.zoom = static_cast<float>(nextNumber());
+    } else if (strcmp(argv[i], "--present-mode") == 0) {
+      std::string const mode = nextValue();
+      if (mode == "immediate") {
+        settings.presentMode = PresentMode::Immediate;
+      } else if (mode == "mailbox") {
+        settings.presentMode = PresentMode::Mailbox;
+      } else if (mode == "fifo") {
+        settings.presentMode = PresentMode::Fifo;
+      } else if (mode == "fifo-relaxed") {
+        settings.presentMode = PresentMode::FifoRelaxed;
+      } else {
+        exitWithUsage("Unknown present mode " + mode);
+      }
+    } else if (strcmp(argv[i], "--fps-limit") == 0) {
+      settings.frameRateLimit = nextNumber();
+    } else if (strcmp(argv[i], "--headless") == 0) {
+      settings.headless = true;
+    } else if (strcmp(argv[i], "--frames") == 0) {
+      settings.headlessFrameCount = nextCount(0);
+    } else if (strcmp(argv[i], "--width") == 0) {
+      settings.width = nextCount(1);
+    } else if (strcmp(argv[i], "--height") == 0) {
+      settings.height = nextCount(1);
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      settings.profile = true;
+    } else if (strcmp(argv[i], "--print-render-graph") == 0) {
+      settings.printRenderGraph = true;
+    } else if (strcmp(argv[i], "--profile-output") == 0) {
+      settings.profile = true;
+      settings.profileOutput = nextValue();
+    } else if (strcmp(argv[i], "--startup-profile-output") == 0) {
+      settings.profile = true;
+      settings.startupProfileOutput = nextValue();
+    } else if (strcmp(argv[i], "--shader-dir") == 0) {
+      settings.shaderDirectory = nextValue();
+    } else if (strcmp(argv[i], "--watch-shaders") == 0) {
+      settings.shaderSourceDirectory = nextValue();
+    } else if (strcmp(argv[i], "--validation-level") == 0) {
+      std::string const level = nextValue();
+      if (level == "verbose") {
+        settings.validationLevel = ValidationLevel::Verbose;
+      } else if (level == "info") {
+        settings.validationLevel = ValidationLevel::Info;
+      } else if (level == "warning") {
+        settings.validationLevel = ValidationLevel::Warning;
+      } else if (level == "error") {
+        settings.validationLevel = ValidationLevel::Error;
+      } else {
+        exitWithUsage("Unknown validation level " + level);
+      }
+    } else if (strcmp(argv[i], "--no-validation-performance") == 0) {
+      settings.validationPerformance = false;
+    } else if (strcmp(argv[i], "--validation-output") == 0) {
+      settings.validationOutput = nextValue();
+    } else if (strcmp(argv[i], "--pipeline-cache") == 0) {
+      settings.pipelineCachePath = nextValue();
+    } else {
+      exitWithUsage(std::string("Unknown argument ") + argv[i]);
+    }
+  }
+
+  if (settings.recordMode == RecordMode::Parallel &&
+      settings.drawPath == DrawPath::Indirect) {
+    exitWithUsage("--record-mode parallel only supports the direct draw path");
+  }
+
+  return settings;
+}
+
+int main(int argc, char **argv) {
   const auto glfwErrorCallback = [](int error, const char *description) {
     std::cerr << "GLFW error: " << description << std::endl;
   };
 
+  Settings settings = parseSettings(argc, argv);
+
+  if (settings.headless) {
+    Application app(settings);
+    app.init();
+    app.run();
+    return 0;
+  }
+
   if (!glfwInit()) {
     std::cerr << "Failed to initialize GLFW" << std::endl;
     exit(EXIT_FAILURE);
@@ -18,9 +281,9 @@ int main(int, char **) {
   glfwSetErrorCallback(glfwErrorCallback);
 
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+  glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-  Application app;
+  Application app(settings);
   app.init();
   app.run();
 